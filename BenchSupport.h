@@ -0,0 +1,175 @@
+/**
+ * The keys, options and output shared by the benchmark programs
+ * @author ketsubetsu
+ * <pre>
+ * File: BenchSupport.h
+ * </pre>
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_SUPPORT_H
+#define BENCH_SUPPORT_H
+
+using namespace std;
+
+/**
+ * the part of the description of a benchmark run that every benchmark has
+ */
+struct BenchConfig
+{
+   /**
+    * the key type; "int" or "string"
+    */
+   string type;
+   /**
+    * the number of keys in the tree before the timed operations
+    */
+   long size;
+   /**
+    * the number of timed operations
+    */
+   long ops;
+   /**
+    * the seed of the random number generators
+    */
+   unsigned long seed;
+};
+
+/**
+ * Gives the key with the specified index; the keys are even numbers so
+ * that an absent key can fall between any two of them
+ * @param index the index of the key
+ * @param key the key with the specified index
+ * @param absent whether to give instead the key just after it, which is
+ * never inserted
+ */
+inline void makeKey(uint64_t index, int& key, bool absent = false)
+{
+   key = static_cast<int>(2 * index + absent);
+}
+
+/**
+ * Gives the key with the specified index; the keys are zero-padded so
+ * that they sort in the same order as their indexes
+ * @param index the index of the key
+ * @param key the key with the specified index
+ * @param absent whether to give instead the key just after it, which is
+ * never inserted
+ */
+inline void makeKey(uint64_t index, string& key, bool absent = false)
+{
+   char buffer[24];
+   snprintf(buffer, sizeof(buffer), "key%012llu", static_cast<unsigned long long>(2 * index + absent));
+   key = buffer;
+}
+
+/**
+ * Gives the elapsed time since the specified time point
+ * @param start a time point
+ * @return the number of nanoseconds since start
+ */
+inline double elapsedNs(chrono::steady_clock::time_point start)
+{
+   return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Splits a comma-separated list
+ * @param list the list to be split
+ * @return the items in the list
+ */
+inline vector<string> splitList(const string& list)
+{
+   vector<string> items;
+   stringstream stream(list);
+   string item;
+   while (getline(stream, item, ','))
+      if (!item.empty())
+         items.push_back(item);
+   return items;
+}
+
+/**
+ * Gives the value of a command-line option of the form --name=value
+ * @param arg the command-line argument
+ * @return the text after the first '=', or "" if there is none
+ */
+inline string optionValue(const string& arg)
+{
+   size_t equals = arg.find('=');
+   return equals == string::npos ? "" : arg.substr(equals + 1);
+}
+
+/**
+ * Gives a count written as an integer or in scientific notation, such as
+ * 1e6
+ * @param value the text of the count
+ * @return the count, 0 if the text is not a number
+ */
+inline long countValue(const string& value)
+{
+   return static_cast<long>(strtod(value.c_str(), nullptr));
+}
+
+/**
+ * Writes the usage of a program to the standard error and exits
+ * @param usage the usage line
+ */
+[[noreturn]] inline void exitWithUsage(const string& usage)
+{
+   cerr<<"Usage: "<<usage<<endl;
+   exit(1);
+}
+
+/**
+ * A JSON array written to a stream one element at a time, so that the
+ * results of a long series of runs appear as they finish
+ */
+class JsonArray
+{
+private:
+   /**
+    * the stream the array is written to
+    */
+   ostream& out;
+   /**
+    * whether no element has been started yet
+    */
+   bool first;
+public:
+   /**
+    * Opens an array on the specified stream
+    * @param stream the stream the array is written to
+    */
+   explicit JsonArray(ostream& stream) : out(stream), first(true)
+   {
+      out<<"["<<endl;
+   }
+   /**
+    * Starts the next element; it is written to the stream after this
+    * @return the stream the element is written to
+    */
+   ostream& next()
+   {
+      out<<(first ? "  " : ",\n  ");
+      first = false;
+      return out;
+   }
+   /**
+    * Closes the array
+    */
+   void close()
+   {
+      out<<"\n]"<<endl;
+   }
+};
+
+#endif //BENCH_SUPPORT_H
@@ -16,17 +16,112 @@ template <typename U>
 template <typename T>
 Bstree<U>::Node<T>::Node(T item)
 {
-   data = item;
+   data = std::move(item);
    left = nullptr;
    right = nullptr;
+   block = nullptr;
+   dead = false;
+}
+
+/* Nested Finger class definitions */
+template <typename T>
+Bstree<T>::Finger::Finger()
+{
+   tree = nullptr;
+   id = shape = 0;
 }
 
 /* Outer Bstree class definitions */
+template <typename T>
+atomic<unsigned long> Bstree<T>::ids(0);
+
 template <typename T>
 Bstree<T>::Bstree()
 {
    root = nullptr;
    order = 0;
+   splayMode = false;
+   filterRate = 0;
+   filterCapacity = 0;
+   filterProbes = 0;
+   filterStale = 0;
+   filterDirty = false;
+   filterQueries = filterRejects = 0;
+   tombstones = 0;
+   tombstoneLimit = 0;
+   id = ids.fetch_add(1, memory_order_relaxed) + 1;
+   shape = 0;
+   BSTREE_METRIC(lastDescent = 0;)
+}
+
+template <typename T>
+Bstree<T>::Bstree(const Bstree<T>& other)
+{
+   root = nullptr;
+   order = 0;
+   splayMode = other.splayMode;
+   filterBits = other.filterBits;
+   filterRate = other.filterRate;
+   filterCapacity = other.filterCapacity;
+   filterProbes = other.filterProbes;
+   filterStale = other.filterStale;
+   filterDirty = other.filterDirty;
+   filterQueries = filterRejects = 0;
+   tombstones = 0;
+   tombstoneLimit = other.tombstoneLimit;
+   id = ids.fetch_add(1, memory_order_relaxed) + 1;
+   shape = 0;
+   BSTREE_METRIC(lastDescent = 0;)
+   if (other.root)
+   {
+      root = clone(other.root, other.order + other.tombstones);
+      order = other.order;
+      tombstones = other.tombstones;
+   }
+}
+
+template <typename T>
+Bstree<T>::Bstree(Bstree<T>&& other) noexcept
+{
+   root = other.root;
+   order = other.order;
+   splayMode = other.splayMode;
+   filterBits = std::move(other.filterBits);
+   filterRate = other.filterRate;
+   filterCapacity = other.filterCapacity;
+   filterProbes = other.filterProbes;
+   filterStale = other.filterStale;
+   filterDirty = other.filterDirty;
+   filterQueries = filterRejects = 0;
+   tombstones = other.tombstones;
+   tombstoneLimit = other.tombstoneLimit;
+   id = ids.fetch_add(1, memory_order_relaxed) + 1;
+   shape = 0;
+   BSTREE_METRIC(lastDescent = 0;)
+   other.root = nullptr;
+   other.order = 0;
+   other.tombstones = 0;
+   other.filterDirty = true;
+   other.reshape();
+}
+
+template <typename T>
+Bstree<T>& Bstree<T>::operator=(const Bstree<T>& other)
+{
+   if (this != &other)
+   {
+      Bstree<T> copy(other);
+      swap(copy);
+   }
+   return *this;
+}
+
+template <typename T>
+Bstree<T>& Bstree<T>::operator=(Bstree<T>&& other) noexcept
+{
+   if (this != &other)
+      swap(other);
+   return *this;
 }
 
 template <typename T>
@@ -35,41 +130,114 @@ Bstree<T>::~Bstree()
    recDestroy(root);
 }
 
+template <typename T>
+void Bstree<T>::swap(Bstree<T>& other) noexcept
+{
+   std::swap(root, other.root);
+   std::swap(order, other.order);
+   std::swap(splayMode, other.splayMode);
+   filterBits.swap(other.filterBits);
+   std::swap(filterRate, other.filterRate);
+   std::swap(filterCapacity, other.filterCapacity);
+   std::swap(filterProbes, other.filterProbes);
+   std::swap(filterStale, other.filterStale);
+   std::swap(filterDirty, other.filterDirty);
+   long queries = filterQueries.load(memory_order_relaxed);
+   long rejects = filterRejects.load(memory_order_relaxed);
+   filterQueries.store(other.filterQueries.load(memory_order_relaxed), memory_order_relaxed);
+   filterRejects.store(other.filterRejects.load(memory_order_relaxed), memory_order_relaxed);
+   other.filterQueries.store(queries, memory_order_relaxed);
+   other.filterRejects.store(rejects, memory_order_relaxed);
+   std::swap(tombstones, other.tombstones);
+   std::swap(tombstoneLimit, other.tombstoneLimit);
+   reshape();
+   other.reshape();
+}
+
+template <typename T>
+void swap(Bstree<T>& first, Bstree<T>& second) noexcept
+{
+   first.swap(second);
+}
+
 template <typename T>
 bool Bstree<T>::empty() const
 {
-   return root == nullptr;
+   return order == 0;
 }
 
 template<typename T>
 void Bstree<T>::insert(T item)
 {
    Node<T>* tmp;
-   Node<T>* newnode = new Node<T>(item);
+   Node<T>* newnode = new Node<T>(std::move(item));
+   const T& key = newnode->data;
+   BSTREE_METRIC(counters.allocations++;)
+   BSTREE_METRIC(long depth = 0;)
 
    /* If it is the first node in the tree */
    if (!root)
    {
       root = newnode;
       order++;
+      filterInserted(key);
+      BSTREE_METRIC(record(BstreeMetrics::INSERT, 0, false);)
+      return;
+   }
+   if (splayMode)
+   {
+      root = splay(root, key);
+      BSTREE_METRIC(record(BstreeMetrics::INSERT, lastDescent, root->data == key);)
+      if (root->data == key)
+      { /* Key already exists. */
+         root->data = std::move(newnode->data);
+         delete newnode;
+         BSTREE_METRIC(counters.deallocations++;)
+         if (root->dead)
+            revive(root);
+         return;
+      }
+      /* the new node becomes the root */
+      if (root->data > key)
+      {
+         newnode->left = root->left;
+         newnode->right = root;
+         root->left = nullptr;
+      }
+      else
+      {
+         newnode->right = root->right;
+         newnode->left = root;
+         root->right = nullptr;
+      }
+      root = newnode;
+      order++;
+      filterInserted(key);
       return;
    }
    /*find where it should go */
    tmp = root;
    while (true)
    {
-      if (tmp->data == item)
+      BSTREE_METRIC(depth++;)
+      if (tmp->data == key)
       { /* Key already exists. */
-         tmp->data = item;
+         tmp->data = std::move(newnode->data);
          delete newnode; /* dont need it */
+         BSTREE_METRIC(counters.deallocations++;)
+         BSTREE_METRIC(record(BstreeMetrics::INSERT, depth, true);)
+         if (tmp->dead)
+            revive(tmp);
          return;
       }
-      else if (tmp->data > item)
+      else if (tmp->data > key)
       {
          if (!(tmp->left))
          {/* If the key is less than tmp */
             tmp->left = newnode;
             order++;
+            filterInserted(key);
+            BSTREE_METRIC(record(BstreeMetrics::INSERT, depth, false);)
             return;
          }
          else
@@ -83,6 +251,8 @@ void Bstree<T>::insert(T item)
          {/* If the key is greater than tmp */
             tmp->right = newnode;
             order++;
+            filterInserted(key);
+            BSTREE_METRIC(record(BstreeMetrics::INSERT, depth, false);)
             return;
          }
          else
@@ -97,18 +267,40 @@ template<typename T>
 bool Bstree<T>::inTree(T item) const
 {
    Node<T>* tmp;
+   BSTREE_METRIC(long depth = 0;)
    if (!root)
+   {
+      BSTREE_METRIC(record(BstreeMetrics::SEARCH, 0, false);)
+      return false;
+   }
+   if (!filterMayContain(item))
+   {
+      BSTREE_METRIC(record(BstreeMetrics::SEARCH, 0, false);)
       return false;
+   }
+   if (splayMode)
+   {
+      root = splay(root, item);
+      BSTREE_METRIC(record(BstreeMetrics::SEARCH, lastDescent, root->data == item);)
+      return root->data == item && !root->dead;
+   }
    /*find where it is */
    tmp = root;
    while (true)
    {
+      BSTREE_METRIC(depth++;)
       if (tmp->data == item)
-         return true;
+      {
+         BSTREE_METRIC(record(BstreeMetrics::SEARCH, depth, true);)
+         return !tmp->dead;
+      }
       else if (tmp->data > item)
       {
          if (!(tmp->left))
+         {
+            BSTREE_METRIC(record(BstreeMetrics::SEARCH, depth, false);)
             return false;
+         }
          else
          {/* continue searching */
             tmp = tmp->left;
@@ -117,7 +309,10 @@ bool Bstree<T>::inTree(T item) const
       else
       {
          if (!(tmp->right))
+         {
+            BSTREE_METRIC(record(BstreeMetrics::SEARCH, depth, false);)
             return false;
+         }
          else
             /* continue searching for insertion pt. */
             tmp = tmp->right;
@@ -128,11 +323,62 @@ bool Bstree<T>::inTree(T item) const
 template<typename T>
 bool Bstree<T>::remove(const T& item)
 {
+   if (!filterMayContain(item))
+   {
+      BSTREE_METRIC(record(BstreeMetrics::REMOVE, 0, false);)
+      return false;
+   }
+   if (tombstoneLimit > 0)
+   { /* lazy: mark the node dead where it is */
+      Node<T>* node = nullptr;
+      if (splayMode && root)
+      {
+         root = splay(root, item);
+         if (root->data == item)
+            node = root;
+      }
+      else if (!splayMode)
+         node = search(item);
+      BSTREE_METRIC(record(BstreeMetrics::REMOVE, lastDescent, node != nullptr);)
+      if (!node || node->dead)
+         return false;
+      node->dead = true;
+      order--;
+      tombstones++;
+      filterRemoved(1);
+      if (tombstones > tombstoneLimit * (order + tombstones))
+         compact();
+      return true;
+   }
+   if (splayMode)
+   {
+      if (!root)
+         return false;
+      root = splay(root, item);
+      BSTREE_METRIC(record(BstreeMetrics::REMOVE, lastDescent, root->data == item);)
+      if (!(root->data == item) || root->dead)
+         return false;
+      Node<T>* node = root;
+      /* the largest item of the left subtree becomes the root */
+      if (node->left)
+      {
+         root = splay(node->left, item);
+         root->right = node->right;
+      }
+      else
+         root = node->right;
+      release(node);
+      order--;
+      filterRemoved(1);
+      return true;
+   }
    Node<T>* nodeptr = search(item);
-   if (nodeptr)
+   BSTREE_METRIC(record(BstreeMetrics::REMOVE, lastDescent, nodeptr != nullptr);)
+   if (nodeptr && !nodeptr->dead)
    {
       remove(nodeptr);
       order--;
+      filterRemoved(1);
       return true;
    }
    return false;
@@ -144,8 +390,22 @@ const T& Bstree<T>::retrieve(const T& key) const
    Node<T>* nodeptr;
    if (!root)
       throw BstreeException("Exception:tree empty on retrieve().");
+   if (!filterMayContain(key))
+   {
+      BSTREE_METRIC(record(BstreeMetrics::SEARCH, 0, false);)
+      throw BstreeException("Exception: non-existent key on retrieve().");
+   }
+   if (splayMode)
+   {
+      root = splay(root, key);
+      BSTREE_METRIC(record(BstreeMetrics::SEARCH, lastDescent, root->data == key);)
+      if (!(root->data == key) || root->dead)
+         throw BstreeException("Exception: non-existent key on retrieve().");
+      return root->data;
+   }
    nodeptr = search(key);
-   if (!nodeptr)
+   BSTREE_METRIC(record(BstreeMetrics::SEARCH, lastDescent, nodeptr != nullptr);)
+   if (!nodeptr || nodeptr->dead)
       throw BstreeException("Exception: non-existent key on retrieve().");
    return nodeptr->data;
 }
@@ -165,23 +425,164 @@ long Bstree<T>::size() const
 template<typename T>
 void Bstree<T>::recDestroy(Node<T>* root)
 {
-   if (root)
+   /* rotate left children up so that no stack is needed for deep trees */
+   Node<T>* next;
+   while (root)
    {
-      if (root->left) recDestroy(root->left);
-      if (root->right) recDestroy(root->right);
-      delete root;
+      if (root->left)
+      {
+         next = root->left;
+         root->left = next->right;
+         next->right = root;
+      }
+      else
+      {
+         next = root->right;
+         release(root);
+      }
+      root = next;
    }
 }
 
+template<typename T>
+void Bstree<T>::reshape() const
+{
+   shape++;
+}
+
+template<typename T>
+Bstree<T>::Node<T>* Bstree<T>::splay(Node<T>* node, const T& key) const
+{
+   /* the trees of the nodes left of and right of the search path; the
+    * hooks are where the next node of each is linked */
+   Node<T>* lessRoot = nullptr;
+   Node<T>* greaterRoot = nullptr;
+   Node<T>** lessHook = &lessRoot;
+   Node<T>** greaterHook = &greaterRoot;
+   Node<T>* rotated;
+   reshape();
+   BSTREE_METRIC(lastDescent = 1;)
+   while (true)
+   {
+      if (node->data > key)
+      {
+         if (!node->left)
+            break;
+         if (node->left->data > key)
+         { /* zig-zig: rotate right */
+            rotated = node->left;
+            node->left = rotated->right;
+            rotated->right = node;
+            node = rotated;
+            BSTREE_METRIC(lastDescent++;)
+            if (!node->left)
+               break;
+         }
+         *greaterHook = node;
+         greaterHook = &node->left;
+         node = node->left;
+      }
+      else if (key > node->data)
+      {
+         if (!node->right)
+            break;
+         if (key > node->right->data)
+         { /* zig-zig: rotate left */
+            rotated = node->right;
+            node->right = rotated->left;
+            rotated->left = node;
+            node = rotated;
+            BSTREE_METRIC(lastDescent++;)
+            if (!node->right)
+               break;
+         }
+         *lessHook = node;
+         lessHook = &node->right;
+         node = node->right;
+      }
+      else
+         break;
+      BSTREE_METRIC(lastDescent++;)
+   }
+   *lessHook = node->left;
+   *greaterHook = node->right;
+   node->left = lessRoot;
+   node->right = greaterRoot;
+   return node;
+}
+
+template<typename T>
+void Bstree<T>::release(Node<T>* node)
+{
+   NodeBlock* block = node->block;
+   if (!block)
+   {
+      delete node;
+      BSTREE_METRIC(counters.deallocations++;)
+      return;
+   }
+   node->~Node<T>();
+   if (--block->live == 0)
+   {
+      ::operator delete(block);
+      BSTREE_METRIC(counters.deallocations++;)
+   }
+}
+
+template<typename T>
+Bstree<T>::Node<T>* Bstree<T>::clone(const Node<T>* subtreeRoot, long count)
+{
+   /* the nodes follow the header, suitably aligned */
+   const size_t offset = (sizeof(NodeBlock) + alignof(Node<T>) - 1) / alignof(Node<T>) * alignof(Node<T>);
+   void* memory = ::operator new(offset + count * sizeof(Node<T>));
+   BSTREE_METRIC(counters.allocations++;)
+   NodeBlock* block = new (memory) NodeBlock;
+   block->live = 0;
+   Node<T>* nodes = reinterpret_cast<Node<T>*>(static_cast<char*>(memory) + offset);
+   Node<T>* copyRoot = nullptr;
+   /* copy in preorder; each entry is a source node and the link to fill */
+   vector<pair<const Node<T>*, Node<T>**>> stack;
+   stack.push_back(make_pair(subtreeRoot, &copyRoot));
+   try
+   {
+      while (!stack.empty())
+      {
+         const Node<T>* source = stack.back().first;
+         Node<T>** link = stack.back().second;
+         stack.pop_back();
+         Node<T>* copy = new (nodes + block->live) Node<T>(source->data);
+         copy->block = block;
+         copy->dead = source->dead;
+         block->live++;
+         *link = copy;
+         if (source->right)
+            stack.push_back(make_pair(source->right, &copy->right));
+         if (source->left)
+            stack.push_back(make_pair(source->left, &copy->left));
+      }
+   }
+   catch (...)
+   {
+      for (long i = 0; i < block->live; i++)
+         nodes[i].~Node<T>();
+      ::operator delete(memory);
+      BSTREE_METRIC(counters.deallocations++;)
+      throw;
+   }
+   return copyRoot;
+}
+
 template<typename T>
 Bstree<T>::Node<T>* Bstree<T>::findParent(Node<T>* node)
 {
    Node<T>* tmp = root;
+   BSTREE_METRIC(counters.parentWalks++;)
    if (tmp == node)
       return nullptr;
    while(true)
    {
       //assert(tmp->data != node->data);
+      BSTREE_METRIC(counters.parentSteps++;)
       if (!tmp)
          return nullptr;
       if (tmp->data > node->data)
@@ -209,7 +610,8 @@ void Bstree<T>::inorderTraverse(Node<T>* node, FuncType apply) const
    if (node)
    {
       inorderTraverse(node->left,apply);
-      apply(node->data);
+      if (!node->dead)
+         apply(node->data);
       inorderTraverse(node->right,apply);
    }
 }
@@ -218,8 +620,10 @@ template<typename T>
 Bstree<T>::Node<T>* Bstree<T>::search(const T& item) const
 {
    Node<T>* tmp = root;
+   BSTREE_METRIC(lastDescent = 0;)
    while(tmp)
    {
+      BSTREE_METRIC(lastDescent++;)
       if (tmp->data == item)
          return tmp;
       else if (tmp->data > item)
@@ -237,16 +641,17 @@ bool Bstree<T>::remove(Node<T>* node)
    T data;
    Node<T> *replacement;
    Node<T>* parent = findParent(node);
-   if (!parent)
-      return false;
+   reshape();
    if (node->left && node->right)
    {
       replacement = node->right;
       while (replacement->left)
          replacement = replacement->left;
       data = replacement->data;
+      bool dead = replacement->dead;
       remove(replacement);
       node->data = data;
+      node->dead = dead;
    }
    else
    {
@@ -262,11 +667,142 @@ bool Bstree<T>::remove(Node<T>* node)
          parent->left = replacement;
       else
          parent->right = replacement;
-      delete node;
+      release(node);
    }
    return true;
 }
 
+#ifdef BSTREE_METRICS
+template<typename T>
+void Bstree<T>::record(BstreeMetrics::Operation operation, long depth, bool found) const
+{
+   counters.calls[operation]++;
+   counters.comparisons[operation] += 2 * depth - (found ? 1 : 0);
+   counters.depths[std::min(depth, static_cast<long>(BstreeMetrics::DEPTHS - 1))]++;
+}
+#endif
+
+template<typename T>
+uint64_t Bstree<T>::filterHash(const T& item)
+{
+   uint64_t h = 0;
+   if constexpr (is_default_constructible<hash<T>>::value)
+      h = static_cast<uint64_t>(hash<T>()(item));
+   /* splitmix64 finalizer; std::hash is often the identity */
+   h ^= h >> 30;
+   h *= 0xbf58476d1ce4e5b9ULL;
+   h ^= h >> 27;
+   h *= 0x94d049bb133111ebULL;
+   h ^= h >> 31;
+   return h;
+}
+
+template<typename T>
+void Bstree<T>::filterAdd(const T& item)
+{
+   uint64_t h = filterHash(item);
+   uint64_t blocks = filterBits.size() / 8;
+   uint64_t* block = &filterBits[static_cast<uint64_t>((static_cast<unsigned __int128>(h) * blocks) >> 64) * 8];
+   uint64_t bits = h * 0x9e3779b97f4a7c15ULL;
+   for (int i = 0; i < filterProbes; i++, bits >>= 9)
+      block[(bits & 511) >> 6] |= 1ULL << (bits & 63);
+}
+
+template<typename T>
+bool Bstree<T>::filterMayContain(const T& item) const
+{
+   if (filterRate == 0 || filterDirty)
+      return true;
+   filterQueries.fetch_add(1, memory_order_relaxed);
+   uint64_t h = filterHash(item);
+   uint64_t blocks = filterBits.size() / 8;
+   const uint64_t* block = &filterBits[static_cast<uint64_t>((static_cast<unsigned __int128>(h) * blocks) >> 64) * 8];
+   uint64_t bits = h * 0x9e3779b97f4a7c15ULL;
+   for (int i = 0; i < filterProbes; i++, bits >>= 9)
+      if (!(block[(bits & 511) >> 6] & (1ULL << (bits & 63))))
+      {
+         filterRejects.fetch_add(1, memory_order_relaxed);
+         return false;
+      }
+   return true;
+}
+
+template<typename T>
+void Bstree<T>::rebuildFilter()
+{
+   /* leave room to double before the filter has to be rebuilt again */
+   filterCapacity = std::max(2 * order, 64L);
+   double bitsPerItem = -log(filterRate) / (log(2.0) * log(2.0));
+   uint64_t blocks = static_cast<uint64_t>(ceil(filterCapacity * bitsPerItem / 512));
+   filterProbes = static_cast<int>(std::min(7.0, std::max(1.0, round(bitsPerItem * log(2.0)))));
+   filterBits.assign(std::max<uint64_t>(blocks, 1) * 8, 0);
+   vector<Node<T>*> stack;
+   if (root)
+      stack.push_back(root);
+   while (!stack.empty())
+   {
+      Node<T>* node = stack.back();
+      stack.pop_back();
+      if (!node->dead)
+         filterAdd(node->data);
+      if (node->left)
+         stack.push_back(node->left);
+      if (node->right)
+         stack.push_back(node->right);
+   }
+   filterStale = 0;
+   filterDirty = false;
+}
+
+template<typename T>
+void Bstree<T>::resetFilter()
+{
+   if (filterRate != 0)
+      rebuildFilter();
+}
+
+template<typename T>
+void Bstree<T>::filterInserted(const T& item)
+{
+   if (filterRate == 0)
+      return;
+   if (filterDirty || order > filterCapacity)
+      rebuildFilter();
+   else
+      filterAdd(item);
+}
+
+template<typename T>
+void Bstree<T>::filterRemoved(long count)
+{
+   if (filterRate == 0)
+      return;
+   filterStale += count;
+   if (filterDirty || filterStale > filterCapacity / 2)
+      rebuildFilter();
+}
+
+template<typename T>
+void Bstree<T>::revive(Node<T>* node)
+{
+   node->dead = false;
+   tombstones--;
+   order++;
+   filterInserted(node->data);
+}
+
+template<typename T>
+Bstree<T>::Node<T>* Bstree<T>::buildBalanced(vector<Node<T>*>& nodes, long lo, long hi)
+{
+   if (lo >= hi)
+      return nullptr;
+   long mid = lo + (hi - lo) / 2;
+   Node<T>* node = nodes[mid];
+   node->left = buildBalanced(nodes, lo, mid);
+   node->right = buildBalanced(nodes, mid + 1, hi);
+   return node;
+}
+
 /****** IMPLEMENT AUGMENTED PRIVATE Bstree FUNCTIONS BELOW ******/
 
 // Private auxiliary function for preorderTraverse
@@ -275,7 +811,8 @@ void Bstree<T>::preorderTraverse(Node<T>* node, FuncType apply) const
 {
   if (node)
   {
-    apply(node->data);
+    if (!node->dead)
+      apply(node->data);
     preorderTraverse(node->left, apply);
     preorderTraverse(node->right, apply);
   }
@@ -289,7 +826,8 @@ void Bstree<T>::postorderTraverse(Node<T>* node, FuncType apply) const
   {
     postorderTraverse(node->left, apply);
     postorderTraverse(node->right, apply);
-    apply(node->data);
+    if (!node->dead)
+      apply(node->data);
   }
 }
 
@@ -358,13 +896,174 @@ void Bstree<T>::trim(Node<T>* node)
 	{
 	    if (node->right)
 	        trim(node->right);
+	    else if (node->dead)
+	    {
+	        remove(node);
+	        tombstones--;
+	    }
 	    else
 	    {
-	        remove(node->data);
+	        remove(node);
+	        order--;
+	        filterRemoved(1);
 	    }
 	}
 }
 
+// Private auxiliary function for rangeTraverse
+template <typename T>
+void Bstree<T>::rangeTraverse(Node<T>* node, const T& lo, const T& hi, FuncType apply) const
+{
+  if (node)
+  {
+    bool aboveLo = node->data > lo;
+    bool belowHi = hi > node->data;
+    if (aboveLo)
+      rangeTraverse(node->left, lo, hi, apply);
+    if ((aboveLo || node->data == lo) && (belowHi || node->data == hi) && !node->dead)
+      apply(node->data);
+    if (belowHi)
+      rangeTraverse(node->right, lo, hi, apply);
+  }
+}
+
+// Private auxiliary function for countNodes
+template <typename T>
+long Bstree<T>::countNodes(const Node<T>* node) const
+{
+  if (!node)
+    return 0;
+  return countNodes(node->left) + countNodes(node->right) + 1;
+}
+
+// Private auxiliary function for split, unionWith, intersectWith and differenceWith
+template <typename T>
+Bstree<T>::Node<T>* Bstree<T>::splitNodes(Node<T>* node, const T& key, Node<T>*& less, Node<T>*& greater)
+{
+  Node<T>** lessLink = &less;
+  Node<T>** greaterLink = &greater;
+  while (node)
+  {
+    if (node->data == key)
+    {
+      *lessLink = node->left;
+      *greaterLink = node->right;
+      node->left = node->right = nullptr;
+      return node;
+    }
+    else if (node->data > key)
+    {
+      *greaterLink = node;
+      greaterLink = &node->left;
+      node = node->left;
+    }
+    else
+    {
+      *lessLink = node;
+      lessLink = &node->right;
+      node = node->right;
+    }
+  }
+  *lessLink = *greaterLink = nullptr;
+  return nullptr;
+}
+
+// Private auxiliary function for join, intersectWith and differenceWith
+template <typename T>
+Bstree<T>::Node<T>* Bstree<T>::joinNodes(Node<T>* less, Node<T>* greater)
+{
+  if (!less)
+    return greater;
+  if (!greater)
+    return less;
+  if (!less->right)
+  {
+    less->right = greater;
+    return less;
+  }
+  /* detach the largest item of less and make it the root of both */
+  Node<T>* parent = less;
+  while (parent->right->right)
+    parent = parent->right;
+  Node<T>* top = parent->right;
+  parent->right = top->left;
+  top->left = less;
+  top->right = greater;
+  return top;
+}
+
+// Private auxiliary function for unionWith
+template <typename T>
+Bstree<T>::Node<T>* Bstree<T>::unionNodes(Node<T>* node, Node<T>* other, long& duplicates)
+{
+  if (!node)
+    return other;
+  if (!other)
+    return node;
+  Node<T> *less, *greater;
+  Node<T>* equal = splitNodes(other, node->data, less, greater);
+  if (equal)
+  {
+    node->data = std::move(equal->data);
+    release(equal);
+    duplicates++;
+  }
+  node->left = unionNodes(node->left, less, duplicates);
+  node->right = unionNodes(node->right, greater, duplicates);
+  return node;
+}
+
+// Private auxiliary function for intersectWith
+template <typename T>
+Bstree<T>::Node<T>* Bstree<T>::intersectNodes(Node<T>* node, Node<T>* other, long& kept)
+{
+  if (!node || !other)
+  {
+    recDestroy(node);
+    recDestroy(other);
+    return nullptr;
+  }
+  Node<T> *less, *greater;
+  Node<T>* equal = splitNodes(other, node->data, less, greater);
+  Node<T>* left = intersectNodes(node->left, less, kept);
+  Node<T>* right = intersectNodes(node->right, greater, kept);
+  if (equal)
+  {
+    release(equal);
+    node->left = left;
+    node->right = right;
+    kept++;
+    return node;
+  }
+  release(node);
+  return joinNodes(left, right);
+}
+
+// Private auxiliary function for differenceWith
+template <typename T>
+Bstree<T>::Node<T>* Bstree<T>::differenceNodes(Node<T>* node, Node<T>* other, long& removed)
+{
+  if (!node || !other)
+  {
+    recDestroy(other);
+    return node;
+  }
+  Node<T> *less, *greater;
+  Node<T>* equal = splitNodes(other, node->data, less, greater);
+  Node<T>* left = differenceNodes(node->left, less, removed);
+  Node<T>* right = differenceNodes(node->right, greater, removed);
+  if (equal)
+  {
+    release(equal);
+    release(node);
+    removed++;
+    return joinNodes(left, right);
+  }
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
 // Private auxiliary function for balHeight
 template<typename T>
 long Bstree<T>::balHeight(const Node<T>* node) const
@@ -385,11 +1084,28 @@ long Bstree<T>::balHeight(const Node<T>* node) const
 template <typename T>
 const T& Bstree<T>::max() const
 {
-  if (!root)
+  if (order == 0)
   {
     throw BstreeException("Tree is empty");
   }
   Node<T>* ptr=root;
+  if (tombstones)
+  { /* the right-most live node, in reverse inorder */
+    vector<Node<T>*> stack;
+    while (true)
+    {
+      while (ptr)
+      {
+        stack.push_back(ptr);
+        ptr = ptr->right;
+      }
+      ptr = stack.back();
+      stack.pop_back();
+      if (!ptr->dead)
+        return ptr->data;
+      ptr = ptr->left;
+    }
+  }
   while(ptr->right)
   {
 	  ptr=ptr->right;
@@ -401,11 +1117,28 @@ const T& Bstree<T>::max() const
 template <typename T>
 const T& Bstree<T>::min() const
 {
-  if (!root)
+  if (order == 0)
   {
     throw BstreeException("Tree is empty");
   }
   Node<T>* ptr=root;
+  if (tombstones)
+  { /* the left-most live node, in inorder */
+    vector<Node<T>*> stack;
+    while (true)
+    {
+      while (ptr)
+      {
+        stack.push_back(ptr);
+        ptr = ptr->left;
+      }
+      ptr = stack.back();
+      stack.pop_back();
+      if (!ptr->dead)
+        return ptr->data;
+      ptr = ptr->right;
+    }
+  }
   while(ptr->left)
   {
   	  ptr=ptr->left;
@@ -417,6 +1150,8 @@ const T& Bstree<T>::min() const
 template <typename T>
 void Bstree<T>::trim()
 {
+	/* a live node whose children are all tombstones is a leaf */
+	compact();
 	if (root)
 		trim(root);
 }
@@ -473,3 +1208,427 @@ bool Bstree<T>::isBalanced() const
 	else
 		return true;
 }
+
+// Public function for rangeTraverse
+template <typename T>
+void Bstree<T>::rangeTraverse(const T& lo, const T& hi, FuncType apply) const
+{
+  rangeTraverse(root, lo, hi, apply);
+}
+
+// Public function for rank
+template <typename T>
+long Bstree<T>::rank(const T& item) const
+{
+  long count = 0;
+  vector<Node<T>*> stack;
+  Node<T>* ptr = root;
+  while (ptr || !stack.empty())
+  {
+    while (ptr)
+    {
+      stack.push_back(ptr);
+      ptr = ptr->left;
+    }
+    ptr = stack.back();
+    stack.pop_back();
+    if (!(item > ptr->data))
+      return count;
+    if (!ptr->dead)
+      count++;
+    ptr = ptr->right;
+  }
+  return count;
+}
+
+// Public function for select
+template <typename T>
+const T& Bstree<T>::select(long k) const
+{
+  if (k < 0 || k >= order)
+    throw BstreeException("Exception: rank out of range on select().");
+  vector<Node<T>*> stack;
+  Node<T>* ptr = root;
+  while (true)
+  {
+    while (ptr)
+    {
+      stack.push_back(ptr);
+      ptr = ptr->left;
+    }
+    ptr = stack.back();
+    stack.pop_back();
+    if (!ptr->dead)
+    {
+      if (k == 0)
+        return ptr->data;
+      k--;
+    }
+    ptr = ptr->right;
+  }
+}
+
+// Public function for clear
+template <typename T>
+void Bstree<T>::clear()
+{
+  recDestroy(root);
+  root = nullptr;
+  order = 0;
+  tombstones = 0;
+  resetFilter();
+  reshape();
+}
+
+// Public function for metrics
+template <typename T>
+BstreeMetrics Bstree<T>::metrics() const
+{
+#ifdef BSTREE_METRICS
+  return counters;
+#else
+  return BstreeMetrics();
+#endif
+}
+
+// Public function for resetMetrics
+template <typename T>
+void Bstree<T>::resetMetrics()
+{
+  BSTREE_METRIC(counters = BstreeMetrics();)
+}
+
+// Public function for split
+template <typename T>
+pair<Bstree<T>, Bstree<T>> Bstree<T>::split(const T& key)
+{
+  pair<Bstree<T>, Bstree<T>> halves;
+  compact();
+  Node<T> *less, *greater;
+  Node<T>* equal = splitNodes(root, key, less, greater);
+  if (equal)
+  {
+    equal->right = greater;
+    greater = equal;
+  }
+  halves.first.root = less;
+  halves.first.order = countNodes(less);
+  halves.second.root = greater;
+  halves.second.order = order - halves.first.order;
+  halves.first.filterRate = halves.second.filterRate = filterRate;
+  halves.first.tombstoneLimit = halves.second.tombstoneLimit = tombstoneLimit;
+  halves.first.splayMode = halves.second.splayMode = splayMode;
+  halves.first.resetFilter();
+  halves.second.resetFilter();
+  root = nullptr;
+  order = 0;
+  resetFilter();
+  reshape();
+  return halves;
+}
+
+// Public function for join
+template <typename T>
+void Bstree<T>::join(Bstree<T>& other)
+{
+  if (this == &other || other.empty())
+    return;
+  compact();
+  other.compact();
+  if (root && !(other.min() > max()))
+    throw BstreeException("Exception: overlapping trees on join().");
+  root = joinNodes(root, other.root);
+  order += other.order;
+  other.root = nullptr;
+  other.order = 0;
+  resetFilter();
+  other.resetFilter();
+  reshape();
+  other.reshape();
+}
+
+// Public function for unionWith
+template <typename T>
+void Bstree<T>::unionWith(Bstree<T>& other)
+{
+  if (this == &other)
+    return;
+  compact();
+  other.compact();
+  long duplicates = 0;
+  root = unionNodes(root, other.root, duplicates);
+  order += other.order - duplicates;
+  other.root = nullptr;
+  other.order = 0;
+  resetFilter();
+  other.resetFilter();
+  reshape();
+  other.reshape();
+}
+
+// Public function for intersectWith
+template <typename T>
+void Bstree<T>::intersectWith(Bstree<T>& other)
+{
+  if (this == &other)
+    return;
+  compact();
+  other.compact();
+  long kept = 0;
+  root = intersectNodes(root, other.root, kept);
+  long removed = order - kept;
+  order = kept;
+  filterRemoved(removed);
+  other.root = nullptr;
+  other.order = 0;
+  other.resetFilter();
+  reshape();
+  other.reshape();
+}
+
+// Public function for differenceWith
+template <typename T>
+void Bstree<T>::differenceWith(Bstree<T>& other)
+{
+  if (this == &other)
+  {
+    clear();
+    return;
+  }
+  compact();
+  other.compact();
+  long removed = 0;
+  root = differenceNodes(root, other.root, removed);
+  order -= removed;
+  filterRemoved(removed);
+  other.root = nullptr;
+  other.order = 0;
+  other.resetFilter();
+  reshape();
+  other.reshape();
+}
+
+// Public function for setSplaying
+template <typename T>
+void Bstree<T>::setSplaying(bool on)
+{
+  splayMode = on;
+}
+
+// Public function for splaying
+template <typename T>
+bool Bstree<T>::splaying() const
+{
+  return splayMode;
+}
+
+// Private auxiliary function for find and insert with a hint
+template <typename T>
+bool Bstree<T>::seek(Finger& hint, const T& key, [[maybe_unused]] BstreeMetrics::Operation operation) const
+{
+  typedef typename Finger::Step Step;
+  vector<Step>& path = hint.path;
+  if (hint.tree != this || hint.id != id || hint.shape != shape)
+  {
+    path.clear();
+    hint.tree = this;
+    hint.id = id;
+    hint.shape = shape;
+  }
+  /* the comparisons with the bounds while climbing, and the nodes visited
+   * while descending */
+  BSTREE_METRIC(long checks = 0;)
+  BSTREE_METRIC(long depth = 0;)
+  /* climb to the nearest node whose subtree range holds the key */
+  while (!path.empty())
+  {
+    const Step& top = path.back();
+    bool aboveLo = !top.lo || key > top.lo->data;
+    BSTREE_METRIC(checks += (top.lo ? 1 : 0) + (aboveLo && top.hi ? 1 : 0);)
+    if (aboveLo && (!top.hi || top.hi->data > key))
+      break;
+    path.pop_back();
+  }
+  if (path.empty() && root)
+    path.push_back(Step{root, nullptr, nullptr});
+  /* descend from there */
+  bool found = false;
+  while (!path.empty())
+  {
+    Step top = path.back();
+    BSTREE_METRIC(depth++;)
+    if (top.node->data == key)
+    {
+      found = true;
+      break;
+    }
+    if (top.node->data > key)
+    {
+      if (!top.node->left)
+        break;
+      path.push_back(Step{top.node->left, top.lo, top.node});
+    }
+    else
+    {
+      if (!top.node->right)
+        break;
+      path.push_back(Step{top.node->right, top.node, top.hi});
+    }
+  }
+  BSTREE_METRIC(record(operation, depth, found);)
+  BSTREE_METRIC(counters.comparisons[operation] += checks;)
+  return found;
+}
+
+// Public function for find
+template <typename T>
+bool Bstree<T>::find(Finger& hint, const T& key) const
+{
+  if (!filterMayContain(key))
+  {
+    BSTREE_METRIC(record(BstreeMetrics::SEARCH, 0, false);)
+    return false;
+  }
+  return seek(hint, key, BstreeMetrics::SEARCH) && !hint.path.back().node->dead;
+}
+
+// Public function for insert with a hint
+template <typename T>
+void Bstree<T>::insert(Finger& hint, T item)
+{
+  typedef typename Finger::Step Step;
+  Node<T>* newnode = new Node<T>(std::move(item));
+  BSTREE_METRIC(counters.allocations++;)
+  if (seek(hint, newnode->data, BstreeMetrics::INSERT))
+  { /* Key already exists. */
+    hint.path.back().node->data = std::move(newnode->data);
+    delete newnode;
+    BSTREE_METRIC(counters.deallocations++;)
+    if (hint.path.back().node->dead)
+      revive(hint.path.back().node);
+    return;
+  }
+  if (hint.path.empty())
+  {
+    root = newnode;
+    hint.path.push_back(Step{root, nullptr, nullptr});
+  }
+  else
+  {
+    Step top = hint.path.back();
+    if (top.node->data > newnode->data)
+    {
+      top.node->left = newnode;
+      hint.path.push_back(Step{newnode, top.lo, top.node});
+    }
+    else
+    {
+      top.node->right = newnode;
+      hint.path.push_back(Step{newnode, top.node, top.hi});
+    }
+  }
+  order++;
+  filterInserted(hint.path.back().node->data);
+}
+
+// Public function for setFilter
+template <typename T>
+void Bstree<T>::setFilter(double falsePositiveRate)
+{
+  if (falsePositiveRate == 0)
+  {
+    filterRate = 0;
+    vector<uint64_t>().swap(filterBits);
+    filterCapacity = filterStale = 0;
+    filterProbes = 0;
+    filterDirty = false;
+    return;
+  }
+  if (!(falsePositiveRate > 0 && falsePositiveRate < 1))
+    throw BstreeException("Exception: false-positive rate out of range on setFilter().");
+  if (!is_default_constructible<hash<T>>::value)
+    throw BstreeException("Exception: no std::hash for the items on setFilter().");
+  filterRate = falsePositiveRate;
+  filterQueries = filterRejects = 0;
+  rebuildFilter();
+}
+
+// Public function for filterStats
+template <typename T>
+BstreeFilterStats Bstree<T>::filterStats() const
+{
+  BstreeFilterStats stats;
+  if (filterRate == 0)
+    return stats;
+  stats.enabled = true;
+  stats.falsePositiveRate = filterRate;
+  stats.capacity = filterCapacity;
+  stats.probes = filterProbes;
+  stats.bytes = static_cast<long>(filterBits.size() * sizeof(uint64_t));
+  stats.queries = filterQueries.load(memory_order_relaxed);
+  stats.rejects = filterRejects.load(memory_order_relaxed);
+  stats.staleItems = filterStale;
+  return stats;
+}
+
+// Public function for setLazyDeletion
+template <typename T>
+void Bstree<T>::setLazyDeletion(double maxTombstoneFraction)
+{
+  if (!(maxTombstoneFraction >= 0 && maxTombstoneFraction <= 1))
+    throw BstreeException("Exception: tombstone fraction out of range on setLazyDeletion().");
+  tombstoneLimit = maxTombstoneFraction;
+  if (tombstoneLimit == 0)
+    compact();
+}
+
+// Public function for lazyDeletion
+template <typename T>
+double Bstree<T>::lazyDeletion() const
+{
+  return tombstoneLimit;
+}
+
+// Public function for tombstoneCount
+template <typename T>
+long Bstree<T>::tombstoneCount() const
+{
+  return tombstones;
+}
+
+// Public function for compact
+template <typename T>
+void Bstree<T>::compact()
+{
+  if (tombstones > 0)
+    balance();
+}
+
+// Public function for balance
+template <typename T>
+void Bstree<T>::balance()
+{
+  vector<Node<T>*> live;
+  live.reserve(order);
+  vector<Node<T>*> stack;
+  Node<T>* ptr = root;
+  while (ptr || !stack.empty())
+  {
+    while (ptr)
+    {
+      stack.push_back(ptr);
+      ptr = ptr->left;
+    }
+    ptr = stack.back();
+    stack.pop_back();
+    Node<T>* next = ptr->right;
+    if (ptr->dead)
+      release(ptr);
+    else
+      live.push_back(ptr);
+    ptr = next;
+  }
+  root = buildBalanced(live, 0, static_cast<long>(live.size()));
+  tombstones = 0;
+  reshape();
+}
@@ -11,12 +11,143 @@
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <new>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+#include <utility>
 
 #ifndef BSTREE_H
 #define BSTREE_H
 
 using namespace std;
 
+/**
+ * Compiling with -DBSTREE_METRICS makes every Bstree count the work done by
+ * its search, insert and remove operations; otherwise the counting
+ * statements are compiled out.
+ */
+#ifdef BSTREE_METRICS
+#define BSTREE_METRIC(statement) statement
+#else
+#define BSTREE_METRIC(statement)
+#endif
+
+/**
+ * A snapshot of the state of the membership filter of a Bstree
+ */
+struct BstreeFilterStats
+{
+   /**
+    * whether the tree has a membership filter
+    */
+   bool enabled;
+   /**
+    * the target false-positive rate of the filter
+    */
+   double falsePositiveRate;
+   /**
+    * the number of items the filter is sized for
+    */
+   long capacity;
+   /**
+    * the number of bits tested per lookup
+    */
+   int probes;
+   /**
+    * the memory used by the filter
+    */
+   long bytes;
+   /**
+    * the number of lookups that consulted the filter
+    */
+   long queries;
+   /**
+    * the number of lookups the filter answered without searching the tree
+    */
+   long rejects;
+   /**
+    * the number of removed items still set in the filter
+    */
+   long staleItems;
+   /**
+    * Constructs a snapshot of a tree without a filter
+    */
+   BstreeFilterStats()
+   {
+      enabled = false;
+      falsePositiveRate = 0;
+      capacity = bytes = queries = rejects = staleItems = 0;
+      probes = 0;
+   }
+};
+
+/**
+ * A snapshot of the operation counters of a Bstree
+ */
+struct BstreeMetrics
+{
+   /**
+    * whether the counters are compiled in; when false every counter is 0
+    */
+#ifdef BSTREE_METRICS
+   static constexpr bool enabled = true;
+#else
+   static constexpr bool enabled = false;
+#endif
+   /**
+    * the operations whose descents are counted; retrieve and inTree are
+    * counted as SEARCH
+    */
+   enum Operation { SEARCH, INSERT, REMOVE, OPERATIONS };
+   /**
+    * the number of depth buckets; the last bucket also counts deeper descents
+    */
+   static const int DEPTHS = 64;
+   /**
+    * the number of calls of each operation
+    */
+   long calls[OPERATIONS];
+   /**
+    * the number of key comparisons (== and >) made by each operation
+    */
+   long comparisons[OPERATIONS];
+   /**
+    * depths[d] is the number of descents that visited d nodes
+    */
+   long depths[DEPTHS];
+   /**
+    * the number of nodes allocated with new
+    */
+   long allocations;
+   /**
+    * the number of nodes released with delete
+    */
+   long deallocations;
+   /**
+    * the number of calls of findParent
+    */
+   long parentWalks;
+   /**
+    * the number of nodes visited by findParent
+    */
+   long parentSteps;
+   /**
+    * Constructs a snapshot with every counter set to 0
+    */
+   BstreeMetrics()
+   {
+      fill(calls, calls + OPERATIONS, 0L);
+      fill(comparisons, comparisons + OPERATIONS, 0L);
+      fill(depths, depths + DEPTHS, 0L);
+      allocations = deallocations = 0;
+      parentWalks = parentSteps = 0;
+   }
+};
+
 /**
  * for report exceptions for the BSTree class
  */
@@ -65,19 +196,177 @@ private:
     * forward declaration of the Node class
     */
    template <typename U> class Node;
+   /**
+    * The header of a contiguous block of nodes allocated by the copy
+    * constructor; the block is returned to the system when the last of its
+    * nodes is released
+    */
+   struct NodeBlock
+   {
+      /**
+       * the number of nodes in this block that are not yet released
+       */
+      long live;
+   };
    /**
     * the number of nodes in this tree
     */
    long order;
    /**
-    * A pointer to the root node of this tree
+    * A pointer to the root node of this tree; a splaying tree moves the
+    * nodes it finds to the root even on const lookups
+    */
+   mutable Node<T>* root;
+   /**
+    * whether accessed nodes are splayed to the root
+    */
+   bool splayMode;
+   /**
+    * the identity of this tree, unique among all the trees ever built, so
+    * that a finger can never mistake a tree for another one built at the
+    * same address
+    */
+   unsigned long id;
+   /**
+    * the source of ids, shared by all trees; it is only used when a tree
+    * is constructed
     */
-   Node<T>* root;
+   static atomic<unsigned long> ids;
    /**
-    * An auxiliary recursive function for the destructor.
+    * changed whenever nodes of this tree may have been relinked, moved to
+    * another tree or released, which makes the fingers into it stale;
+    * adding a leaf keeps every existing path and so keeps this unchanged
+    */
+   mutable unsigned long shape;
+   /**
+    * Gives this tree a new shape, making every finger into it stale
+    */
+   void reshape() const;
+   /**
+    * the blocked Bloom filter of the items of this tree: each item hashes to
+    * one 512-bit block, a cache line, and sets a few bits in it; empty if
+    * this tree has no filter
+    */
+   vector<uint64_t> filterBits;
+   /**
+    * the target false-positive rate of the filter, 0 if there is none
+    */
+   double filterRate;
+   /**
+    * the number of items the filter is sized for
+    */
+   long filterCapacity;
+   /**
+    * the number of bits set and tested per item
+    */
+   int filterProbes;
+   /**
+    * the number of removed items still set in the filter
+    */
+   long filterStale;
+   /**
+    * whether items may have been added to this tree without being added
+    * to the filter; a dirty filter lets every lookup through until the
+    * next insert or remove rebuilds it
+    */
+   bool filterDirty;
+   /**
+    * the number of lookups that consulted the filter and that it rejected;
+    * atomic so that concurrent const lookups may count
+    */
+   mutable atomic<long> filterQueries, filterRejects;
+   /**
+    * Gives a well-mixed hash of the specified item
+    * @param item an item
+    * @return a 64-bit hash of the item
+    */
+   static uint64_t filterHash(const T& item);
+   /**
+    * Sets the bits of the specified item in the filter
+    * @param item the item to be added to the filter
+    */
+   void filterAdd(const T& item);
+   /**
+    * Determines whether the specified item may be in this tree; it only
+    * reads the filter, so concurrent lookups may call it
+    * @param item the search key
+    * @return false if the item is certainly not in this tree; otherwise, true
+    */
+   bool filterMayContain(const T& item) const;
+   /**
+    * Sizes the filter for the current number of items and adds every item
+    * of this tree to it
+    */
+   void rebuildFilter();
+   /**
+    * Rebuilds the filter, if this tree has one, after its items were
+    * replaced wholesale
+    */
+   void resetFilter();
+   /**
+    * Updates the filter after an item was added to this tree, rebuilding
+    * it twice as large once this tree outgrows it or if it is dirty
+    * @param item the added item
+    */
+   void filterInserted(const T& item);
+   /**
+    * Updates the filter after items were removed from this tree; it is
+    * rebuilt once the removed items outnumber half of its capacity or if
+    * it is dirty
+    * @param count the number of removed items
+    */
+   void filterRemoved(long count);
+   /**
+    * the number of dead nodes, removed lazily but not yet unlinked; size()
+    * counts only the live ones
+    */
+   long tombstones;
+   /**
+    * the fraction of dead nodes above which this tree is compacted, or 0
+    * if removals unlink their nodes at once
+    */
+   double tombstoneLimit;
+   /**
+    * Brings a dead node with the key of a newly inserted item back to life
+    * @param node a dead node of this tree
+    */
+   void revive(Node<T>* node);
+   /**
+    * Recursively links the specified nodes into a perfectly balanced tree
+    * @param nodes the live nodes of this tree in inorder
+    * @param lo the index of the first node of the subtree
+    * @param hi one past the index of the last node of the subtree
+    * @return the root of the subtree
+    */
+   Node<T>* buildBalanced(vector<Node<T>*>& nodes, long lo, long hi);
+   /**
+    * Moves the node with the specified key, or the last node on its search
+    * path, to the root of a subtree by top-down splaying
+    * @param node the root of a nonempty subtree
+    * @param key the search key
+    * @return the new root of the subtree
+    */
+   Node<T>* splay(Node<T>* node, const T& key) const;
+   /**
+    * An auxiliary function for the destructor; it uses O(1) extra space
+    * however deep the tree is.
     * @param subtreRoot a pointer to the root of a subtree of this tree
     */
    void recDestroy(Node<T>* subtreeRoot);
+   /**
+    * Returns the memory of the specified node to the system, or to its
+    * block if it was allocated by the copy constructor
+    * @param node a pointer to a node that is no longer in any tree
+    */
+   void release(Node<T>* node);
+   /**
+    * Copies the subtree rooted at the specified node, without recursion,
+    * into a single contiguous block of nodes
+    * @param subtreeRoot the root of a subtree of another tree
+    * @param count the number of nodes in the subtree
+    * @return a pointer to the root of the copy
+    */
+   Node<T>* clone(const Node<T>* subtreeRoot, long count);
    /**
     * Give a pointer to the parent node of the specified Node
     * @param node the node whose parent node is to be found
@@ -104,6 +393,23 @@ private:
     * otherwise, nullptr
     */
    Node<T>* search(const T& item) const;
+#ifdef BSTREE_METRICS
+   /**
+    * the operation counters of this tree
+    */
+   mutable BstreeMetrics counters;
+   /**
+    * the number of nodes visited by the last call of search
+    */
+   mutable long lastDescent;
+   /**
+    * Counts one descent of the specified operation
+    * @param operation the operation that made the descent
+    * @param depth the number of nodes visited
+    * @param found whether the descent ended at a node with the search key
+    */
+   void record(BstreeMetrics::Operation operation, long depth, bool found) const;
+#endif
 
    /****** BEGIN: AUGMENTED PRIVATE FUNCTIONS ******/
 
@@ -158,18 +464,226 @@ private:
     */
     long balHeight(const Node<T>* node) const;
 
+   /**
+    * Traverses the subtree rooted at the specified node in inorder, visiting
+    * only the items in the closed interval [lo, hi]
+    * @param node the root of a subtree
+    * @param lo the smallest item to be visited
+    * @param hi the largest item to be visited
+    * @param apply a pointer to a function of type (const T&) -> void
+    * that is applied to the data field of the visited nodes
+    */
+   void rangeTraverse(Node<T>* node, const T& lo, const T& hi, FuncType apply) const;
+
+   /**
+    * Recursively counts the nodes in the subtree rooted at the specified node
+    * @param node the root of a subtree
+    * @return the number of nodes in the subtree rooted at the specified node
+    */
+   long countNodes(const Node<T>* node) const;
+
+   /**
+    * Splits the subtree rooted at the specified node along the search path
+    * of the specified key, without allocating or copying any node
+    * @param node the root of a subtree
+    * @param key the key to split at
+    * @param less set to the root of the nodes with items less than key
+    * @param greater set to the root of the nodes with items greater than key
+    * @return the detached node whose item equals key, or nullptr
+    */
+   Node<T>* splitNodes(Node<T>* node, const T& key, Node<T>*& less, Node<T>*& greater);
+
+   /**
+    * Joins two subtrees whose items are all ordered, under the right-most
+    * node of the first one as a new root, so that the height of the result
+    * is at most one more than the larger of their heights
+    * @param less the root of a subtree whose items are all less than those
+    * in greater
+    * @param greater the root of a subtree
+    * @return the root of the joined subtree
+    */
+   Node<T>* joinNodes(Node<T>* less, Node<T>* greater);
+
+   /**
+    * Recursively merges two subtrees by relinking their nodes
+    * @param node the root of a subtree of this tree
+    * @param other the root of a subtree of another tree
+    * @param duplicates incremented for each item found in both subtrees
+    * @return the root of the merged subtree
+    */
+   Node<T>* unionNodes(Node<T>* node, Node<T>* other, long& duplicates);
+
+   /**
+    * Recursively keeps the nodes of a subtree whose items are also in
+    * another subtree and releases every other node of both subtrees
+    * @param node the root of a subtree of this tree
+    * @param other the root of a subtree of another tree
+    * @param kept incremented for each node that is kept
+    * @return the root of the intersection
+    */
+   Node<T>* intersectNodes(Node<T>* node, Node<T>* other, long& kept);
+
+   /**
+    * Recursively releases the nodes of a subtree whose items are in another
+    * subtree, as well as every node of the other subtree
+    * @param node the root of a subtree of this tree
+    * @param other the root of a subtree of another tree
+    * @param removed incremented for each node released from this tree
+    * @return the root of the difference
+    */
+   Node<T>* differenceNodes(Node<T>* node, Node<T>* other, long& removed);
+
    /****** END: AUGMENTED PRIVATE FUNCTIONS ******/
 public:
+  /**
+   * forward declaration of the Finger class, a remembered search path used
+   * as a hint by find and insert
+   */
+   class Finger;
+private:
+  /**
+   * Moves the specified finger to the node with the specified key or, if
+   * there is none, to the leaf under which the key would be inserted,
+   * without consulting the filter
+   * @param hint a finger into this tree
+   * @param key the search key
+   * @param operation the operation the search is counted as
+   * @return true if the key is in this tree; otherwise, false
+   */
+   bool seek(Finger& hint, const T& key, BstreeMetrics::Operation operation) const;
+public:
+
   /**
    * Constructs an empty binary search tree;
    */
    Bstree();
 
+  /**
+   * Constructs a copy of the specified tree with the same shape; it takes
+   * O(n) time and allocates all the nodes in one block
+   * @param other the tree to be copied
+   */
+   Bstree(const Bstree<T>& other);
+
+  /**
+   * Constructs a tree that takes over the nodes of the specified tree in
+   * O(1) time; the specified tree is left empty
+   * @param other the tree to be moved
+   */
+   Bstree(Bstree<T>&& other) noexcept;
+
+  /**
+   * Replaces the nodes and the settings of this tree with a copy of the
+   * specified tree
+   * @param other the tree to be copied
+   * @return this tree
+   */
+   Bstree<T>& operator=(const Bstree<T>& other);
+
+  /**
+   * Exchanges the nodes of this tree with those of the specified tree in
+   * O(1) time; the old nodes of this tree are released with the other tree
+   * @param other the tree to be moved
+   * @return this tree
+   */
+   Bstree<T>& operator=(Bstree<T>&& other) noexcept;
+
   /**
    * Returns the binary search tree memory to the system
    */
    virtual ~Bstree();
 
+  /**
+   * Exchanges the nodes of this tree with those of the specified tree in
+   * O(1) time; the membership filters, the tombstones and the splaying
+   * and lazy deletion modes go with the nodes, so that a lazy tree never
+   * hands its dead nodes to an eager one, and the operation counters are
+   * not exchanged
+   * @param other the tree to exchange nodes with
+   */
+   void swap(Bstree<T>& other) noexcept;
+
+  /**
+   * Turns splaying on or off. A splaying tree moves every node found or
+   * inserted by inTree, retrieve or insert to the root, and remove splays
+   * too, which gives amortized O(log n) operations and O(1) repeated
+   * lookups of hot keys. Since inTree and retrieve then restructure the
+   * tree, concurrent lookups are no longer safe.
+   * @param on true to splay on access; false for a plain search tree
+   */
+   void setSplaying(bool on);
+
+  /**
+   * Determines whether this tree splays on access
+   * @return true if this tree splays on access; otherwise, false
+   */
+   bool splaying() const;
+
+  /**
+   * Determines whether an item is in the tree, starting from the position
+   * of the specified finger instead of the root: the search climbs back up
+   * the finger's path only as far as the first subtree whose key range
+   * holds the key, so a search close to the previous one visits few nodes.
+   * The finger is then left at the last node visited. It never splays.
+   * @param hint a finger left by a previous find or insert on this tree,
+   * or a new finger
+   * @param key the search key
+   * @return true if an item with the key is in this tree; otherwise, false
+   */
+   bool find(Finger& hint, const T& key) const;
+
+  /**
+   * Inserts an item into the tree, searching for its place from the
+   * position of the specified finger as find does; the finger is left at
+   * the inserted node. It never splays.
+   * @param hint a finger left by a previous find or insert on this tree,
+   * or a new finger
+   * @param item the value to be inserted
+   */
+   void insert(Finger& hint, T item);
+
+  /**
+   * Moves the nodes of this tree into two new trees along the search path
+   * of the specified key, in time proportional to the height plus the
+   * size of the first tree; this tree is left empty and the new trees
+   * take its filter, splaying and lazy deletion settings
+   * @param key the key to split at
+   * @return the trees of the items less than key and of the items greater
+   * than or equal to key, in that order
+   */
+   pair<Bstree<T>, Bstree<T>> split(const T& key);
+
+  /**
+   * Moves the nodes of the specified tree into this tree when every item in
+   * this tree is less than every item in the other tree; the other tree is
+   * left empty
+   * @param other the tree to be joined to this tree
+   * @throws BstreeException if the items of the two trees overlap
+   */
+   void join(Bstree<T>& other);
+
+  /**
+   * Moves the nodes of the specified tree into this tree; an item in both
+   * trees is overwritten with the item from the other tree, as insert does.
+   * No node is allocated or copied and the other tree is left empty.
+   * @param other the tree to be merged into this tree
+   */
+   void unionWith(Bstree<T>& other);
+
+  /**
+   * Removes the items of this tree that are not in the specified tree; no
+   * node is allocated or copied and the other tree is left empty
+   * @param other the tree to be intersected with this tree
+   */
+   void intersectWith(Bstree<T>& other);
+
+  /**
+   * Removes the items of this tree that are in the specified tree; no node
+   * is allocated or copied and the other tree is left empty
+   * @param other the tree whose items are to be removed from this tree
+   */
+   void differenceWith(Bstree<T>& other);
+
   /**
    * Determines whether the binary search tree is empty.
    * @return true if the tree is empty; otherwise, false
@@ -215,7 +729,8 @@ public:
 
   /**
    * Gives the number of node in this tree
-   * @return the size of the tree; the number of nodes in this tree.
+   * @return the size of the tree; the number of nodes in this tree, not
+   * counting the tombstones of lazily removed items.
    */
    long size() const;
 
@@ -236,7 +751,8 @@ public:
    void postorderTraverse(FuncType apply) const;
 
    /**
-    * Gives the height of this tree
+    * Gives the height of this tree; like countLeaves, countHalves and
+    * isBalanced it describes the shape of the tree, tombstones included
     * @return the height of this tree
     */
    long height() const;
@@ -273,6 +789,108 @@ public:
     */
    bool isBalanced() const;
 
+   /**
+    * Traverses this tree in inorder and applies the function apply once for
+    * each item in the closed interval [lo, hi]
+    * @param lo the smallest item to be visited
+    * @param hi the largest item to be visited
+    * @param apply a pointer to a function of type (const T&) -> void
+    */
+   void rangeTraverse(const T& lo, const T& hi, FuncType apply) const;
+
+   /**
+    * Gives the number of items in this tree that are less than the specified
+    * item; it takes time proportional to the height plus the answer
+    * @param item the item whose rank is to be found
+    * @return the number of items in this tree less than item
+    */
+   long rank(const T& item) const;
+
+   /**
+    * Gives the item of the specified rank, the inverse of rank()
+    * @param k the zero-based rank of the item; 0 gives the minimum
+    * @return the item with exactly k smaller items in this tree
+    * @throw BstreeException when k is negative or not less than size()
+    */
+   const T& select(long k) const;
+
+   /**
+    * Removes all the nodes of this tree
+    */
+   void clear();
+
+   /**
+    * Gives a snapshot of the operation counters of this tree; the counters
+    * are only kept when compiled with -DBSTREE_METRICS
+    * @return a copy of the operation counters of this tree
+    */
+   BstreeMetrics metrics() const;
+
+   /**
+    * Sets the operation counters of this tree to 0
+    */
+   void resetMetrics();
+
+   /**
+    * Puts an approximate membership (Bloom) filter in front of inTree,
+    * retrieve, find and remove, so that most lookups of absent items are
+    * rejected after reading one cache line instead of searching the tree.
+    * The filter is kept up to date by insert; removed items stay in it
+    * until it is rebuilt after many removals. Only inserts, removes and
+    * the other mutators rebuild it, so const lookups from several threads
+    * remain safe on a tree that does not splay. T needs a std::hash.
+    * @param falsePositiveRate the fraction of absent items that may get
+    * past the filter, between 0 and 1 exclusive; 0 removes the filter
+    * @throws BstreeException if the rate is out of range or T has no
+    * std::hash
+    */
+   void setFilter(double falsePositiveRate);
+
+   /**
+    * Gives a snapshot of the state of the membership filter of this tree
+    * @return the size and hit counts of the filter
+    */
+   BstreeFilterStats filterStats() const;
+
+   /**
+    * Turns lazy deletion on or off. A lazy remove only marks the node of
+    * the item as dead, a tombstone that keeps the tree ordered and is
+    * skipped by lookups and traversals, and inserting the item again
+    * revives it. Once the tombstones are more than the specified fraction
+    * of the nodes, the tree is compacted.
+    * @param maxTombstoneFraction the fraction of dead nodes that triggers
+    * a compaction, more than 0 and at most 1; 0 turns lazy deletion off
+    * and compacts the tree
+    * @throws BstreeException if the fraction is out of range
+    */
+   void setLazyDeletion(double maxTombstoneFraction);
+
+   /**
+    * Gives the fraction of dead nodes that triggers a compaction
+    * @return the compaction threshold, or 0 if removals are eager
+    */
+   double lazyDeletion() const;
+
+   /**
+    * Gives the number of tombstones left by lazy removals in this tree
+    * @return the number of dead nodes in this tree
+    */
+   long tombstoneCount() const;
+
+   /**
+    * Unlinks and frees every dead node of this tree in one O(n) pass that
+    * relinks the live nodes into a perfectly balanced tree; it does
+    * nothing if there are no tombstones
+    */
+   void compact();
+
+   /**
+    * Relinks the nodes of this tree into a perfectly balanced tree in one
+    * O(n) pass without copying any item, unlinking and freeing the dead
+    * nodes on the way
+    */
+   void balance();
+
    /****** END: AUGMENTED PUBLIC FUNCTIONS ******/
 };
 
@@ -298,6 +916,16 @@ private:
     * a pointer to the right child of this Node
     */
    Node<T>* right;
+   /**
+    * the block this Node was allocated in, or nullptr if it was allocated
+    * on its own with new
+    */
+   typename Bstree<U>::NodeBlock* block;
+   /**
+    * whether the item of this Node was removed by lazy deletion; the Node
+    * only keeps the tree ordered until the next compaction
+    */
+   bool dead;
    /**
     * Granting friendship - access to private members of this class to the
     * Bstee<U> class
@@ -311,4 +939,55 @@ public:
    Node(T item);
 
 };
+
+/**
+ * nested Finger class definition; a finger stays valid while only inserts
+ * are made to its tree, and silently restarts from the root otherwise
+ * @param <T> the binary search tree data type
+ */
+template <typename T>
+class Bstree<T>::Finger
+{
+private:
+   /**
+    * a node on the path of this finger and the nearest ancestors that bound
+    * the items of its subtree from below and above, nullptr if unbounded
+    */
+   struct Step
+   {
+      Node<T>* node;
+      Node<T>* lo;
+      Node<T>* hi;
+   };
+   /**
+    * the path from the root to the node this finger is at
+    */
+   vector<Step> path;
+   /**
+    * the tree this finger was last used on
+    */
+   const Bstree<T>* tree;
+   /**
+    * the id and the shape of the tree when this finger was last used
+    */
+   unsigned long id, shape;
+   /**
+    * Granting friendship - access to private members of this class to the
+    * Bstee<T> class
+    */
+   friend class Bstree<T>;
+public:
+  /**
+   * Constructs a finger that starts at the root of any tree
+   */
+   Finger();
+};
+
+/**
+ * Exchanges the nodes of two trees in O(1) time
+ * @param first a tree
+ * @param second another tree
+ */
+template <typename T>
+void swap(Bstree<T>& first, Bstree<T>& second) noexcept;
 #endif //BSTREE_H
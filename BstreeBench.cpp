@@ -0,0 +1,496 @@
+/**
+ * A workload generator and benchmark for the binary search tree
+ * @author ketsubetsu
+ * @see Bstree
+ * <pre>
+ * File: BstreeBench.cpp
+ * Build: g++ -std=c++17 -O2 -o bstree_bench BstreeBench.cpp
+ *
+ * Every run builds a Bstree<int> or a Bstree<string> of the given size from
+ * a key distribution and then times a mix of insert, lookup, remove and
+ * traverse operations drawn from the same distribution :-
+ * sequential : keys are built and accessed in ascending order
+ * near-sequential : keys are built and accessed in ascending order, each
+ *                   displaced by up to 8 places
+ * random : keys are built in shuffled order and accessed uniformly
+ * zipf : keys are built in shuffled order and accessed with a Zipfian
+ *        (theta = 0.99) skew towards a few hot keys
+ * sorted-delete : keys are built in ascending order and then all removed
+ *                 in ascending order; the mix is ignored
+ * burst-delete : keys are built in shuffled order and then bursts of
+ *                removes of distinct keys, 4096 or an eighth of the keys
+ *                if fewer, alternate with bursts of as many uniform
+ *                lookups until half of the keys are removed; the mix is
+ *                ignored
+ *
+ * Usage: bstree_bench [--sizes=1e3,1e4,...] [--types=int,string]
+ *                     [--dists=sequential,near-sequential,random,zipf,sorted-delete,burst-delete]
+ *                     [--mix=insert:lookup:remove:traverse] [--ops=N]
+ *                     [--max-degenerate=N] [--seed=N] [--splay] [--hinted]
+ *                     [--filter=rate] [--misses=fraction] [--lazy=fraction]
+ * --sizes : the tree sizes to be benchmarked; 1e3,1e4,1e5,1e6 by default
+ * --mix : the relative weights of the operations; 20:70:10:0 by default
+ * --ops : the number of timed operations; the tree size by default
+ * --max-degenerate : the largest size at which the sequential,
+ *                    near-sequential and sorted-delete distributions are
+ *                    run; they build a tree of height close to n in O(n^2)
+ *                    time, or O(n) when hinted; 20000 by default
+ * --splay : run every benchmark on a splaying tree as well as a plain one
+ * --hinted : run every benchmark with inserts and lookups that start from
+ *            the finger of the previous insert or lookup as well as from
+ *            the root
+ * --filter : give every tree a membership filter with the specified
+ *            false-positive rate
+ * --misses : the fraction of lookups that are for keys not in the tree;
+ *            0 by default
+ * --lazy : remove by leaving tombstones in every tree, compacting it once
+ *          they are more than the specified fraction of its nodes
+ *
+ * Compiling with -DBSTREE_METRICS adds the tree's operation counters for
+ * both phases to every result.
+ *
+ * Each run is forked into its own process so that its peak resident set
+ * size is its own. The results are written to the standard output as a
+ * JSON array with one object per run.
+ * </pre>
+ */
+
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Bstree.cpp"
+#include "BenchSupport.h"
+
+using namespace std;
+
+/**
+ * the description of a benchmark run
+ */
+struct BstreeBenchConfig : BenchConfig
+{
+   /**
+    * the key distribution
+    */
+   string dist;
+   /**
+    * the relative weights of insert, lookup, remove and traverse
+    */
+   long mix[4];
+   /**
+    * whether the tree splays on access
+    */
+   bool splay;
+   /**
+    * whether inserts and lookups are hinted with a finger
+    */
+   bool hinted;
+   /**
+    * the false-positive rate of the membership filter, 0 for none
+    */
+   double filter;
+   /**
+    * the fraction of lookups that are for absent keys
+    */
+   double misses;
+   /**
+    * the fraction of tombstones that triggers a compaction, 0 for eager
+    * removal
+    */
+   double lazy;
+};
+
+/**
+ * the number of operations generated between two clock readings
+ */
+const long BATCH = 4096;
+
+/**
+ * the number of items visited by the traverse operations
+ */
+volatile long visited = 0;
+
+/**
+ * Counts a visited item
+ * @param item the visited item
+ */
+template <typename K>
+void visit(const K&)
+{
+   visited = visited + 1;
+}
+
+/**
+ * A generator of key indexes in [0, n) that follow a Zipfian distribution,
+ * after Gray et al., "Quickly generating billion-record synthetic databases"
+ */
+class ZipfGenerator
+{
+private:
+   /**
+    * the number of key indexes
+    */
+   uint64_t n;
+   /**
+    * the skew of the distribution
+    */
+   double theta;
+   /**
+    * precomputed constants of the distribution
+    */
+   double alpha, zetan, eta, half;
+public:
+   /**
+    * Constructs a generator; it takes O(n) time
+    * @param count the number of key indexes
+    * @param skew the skew of the distribution, less than 1
+    */
+   ZipfGenerator(uint64_t count, double skew)
+   {
+      n = count;
+      theta = skew;
+      zetan = 0;
+      for (uint64_t i = 1; i <= n; i++)
+         zetan += 1.0 / pow(static_cast<double>(i), theta);
+      double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+      alpha = 1.0 / (1.0 - theta);
+      eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+      half = pow(0.5, theta);
+   }
+   /**
+    * Gives the next key index
+    * @param rng a source of randomness
+    * @return a key index; 0 is the most frequent
+    */
+   uint64_t next(mt19937_64& rng)
+   {
+      double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+      double uz = u * zetan;
+      if (uz < 1.0)
+         return 0;
+      if (uz < 1.0 + half)
+         return 1;
+      uint64_t index = static_cast<uint64_t>(n * pow(eta * u - eta + 1.0, alpha));
+      return std::min(index, n - 1);
+   }
+};
+
+/**
+ * Gives the peak resident set size of this process
+ * @return the peak resident set size in kilobytes
+ */
+long peakRssKb()
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_maxrss;
+}
+
+/**
+ * Runs one benchmark and writes its result as a JSON object
+ * @param config the run to be benchmarked
+ * @param json the stream the result is written to
+ */
+template <typename K>
+void runBench(const BstreeBenchConfig& config, ostream& json)
+{
+   mt19937_64 rng(config.seed);
+   uint64_t n = static_cast<uint64_t>(config.size);
+   bool nearly = config.dist == "near-sequential";
+   bool ascending = config.dist == "sequential" || config.dist == "sorted-delete" || nearly;
+   Bstree<K> tree;
+   tree.setSplaying(config.splay);
+   if (config.filter > 0)
+      tree.setFilter(config.filter);
+   tree.setLazyDeletion(config.lazy);
+   bool bursty = config.dist == "burst-delete";
+   typename Bstree<K>::Finger finger, lookupFinger;
+   K key;
+
+   /* build phase */
+   vector<uint32_t> order;
+   if (!ascending || nearly)
+   {
+      order.resize(n);
+      for (uint64_t i = 0; i < n; i++)
+         order[i] = static_cast<uint32_t>(i);
+      if (nearly)
+         for (uint64_t i = 0; i + 1 < n; i++)
+            std::swap(order[i], order[std::min(n - 1, i + rng() % 9)]);
+      else
+         shuffle(order.begin(), order.end(), rng);
+   }
+   double buildNs = 0;
+   vector<K> batch;
+   batch.reserve(BATCH);
+   for (uint64_t done = 0; done < n; )
+   {
+      batch.clear();
+      for (; done < n && static_cast<long>(batch.size()) < BATCH; done++)
+      {
+         makeKey(order.empty() ? done : order[done], key);
+         batch.push_back(key);
+      }
+      auto start = chrono::steady_clock::now();
+      if (config.hinted)
+         for (const K& item : batch)
+            tree.insert(finger, item);
+      else
+         for (const K& item : batch)
+            tree.insert(item);
+      buildNs += elapsedNs(start);
+   }
+   if (bursty)
+      shuffle(order.begin(), order.end(), rng);
+   else
+      vector<uint32_t>().swap(order);
+
+   /* timed phase */
+   enum { INSERT, LOOKUP, REMOVE, TRAVERSE };
+   long weights[4] = {config.mix[0], config.mix[1], config.mix[2], config.mix[3]};
+   long ops = config.ops;
+   if (config.dist == "sorted-delete")
+   {
+      weights[INSERT] = weights[LOOKUP] = weights[TRAVERSE] = 0;
+      weights[REMOVE] = 1;
+      ops = config.size;
+   }
+   if (bursty)
+   {
+      weights[INSERT] = weights[REMOVE] = weights[TRAVERSE] = 0;
+      weights[LOOKUP] = 1;
+      ops = 2 * (config.size / 2);
+   }
+   discrete_distribution<int> pickOp(weights, weights + 4);
+   uniform_int_distribution<uint64_t> uniform(0, n > 0 ? n - 1 : 0);
+   ZipfGenerator* zipf = config.dist == "zipf" ? new ZipfGenerator(n, 0.99) : nullptr;
+   bernoulli_distribution pickMiss(config.misses);
+   uint64_t cursor[3] = {n, 0, 0};
+   vector<int> kinds;
+   kinds.reserve(BATCH);
+   long counts[4] = {0, 0, 0, 0};
+   long hits = 0;
+   double opsNs = 0, removeNs = 0;
+   /* small trees get shorter bursts, so that they see several of each */
+   long burst = std::max(1L, std::min(BATCH, static_cast<long>(n / 8)));
+   long limit = BATCH;
+   bool removing = false;
+   for (long done = 0; done < ops; )
+   {
+      /* burst-delete batches remove the next distinct keys and look up
+       * as many uniform keys in turn */
+      if (bursty)
+      {
+         removing = !removing;
+         if (removing)
+            limit = std::min(burst, static_cast<long>(n / 2 - cursor[REMOVE]));
+      }
+      batch.clear();
+      kinds.clear();
+      for (; done < ops && static_cast<long>(batch.size()) < limit; done++)
+      {
+         int kind = removing ? static_cast<int>(REMOVE) : pickOp(rng);
+         uint64_t index;
+         if (removing)
+            index = order[cursor[REMOVE]++];
+         else if (ascending)
+         {
+            index = kind == TRAVERSE ? 0 : cursor[kind]++;
+            if (nearly && index >= 8)
+               index += rng() % 17 - 8;
+         }
+         else if (zipf)
+            index = zipf->next(rng);
+         else
+            index = uniform(rng);
+         if (ascending && kind != INSERT)
+            index %= std::max<uint64_t>(n, 1);
+         makeKey(index, key, kind == LOOKUP && config.misses > 0 && pickMiss(rng));
+         kinds.push_back(kind);
+         batch.push_back(key);
+         counts[kind]++;
+      }
+      auto start = chrono::steady_clock::now();
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+         switch (kinds[i])
+         {
+            case INSERT:
+               if (config.hinted)
+                  tree.insert(finger, batch[i]);
+               else
+                  tree.insert(batch[i]);
+               break;
+            case LOOKUP:
+               hits += config.hinted ? tree.find(lookupFinger, batch[i]) : tree.inTree(batch[i]);
+               break;
+            case REMOVE:
+               hits += tree.remove(batch[i]);
+               break;
+            default:
+               tree.inorderTraverse(visit<K>);
+         }
+      }
+      double batchNs = elapsedNs(start);
+      opsNs += batchNs;
+      if (removing)
+         removeNs += batchNs;
+   }
+   delete zipf;
+
+   json<<"{\"type\":\""<<config.type<<"\",\"distribution\":\""<<config.dist<<"\""
+       <<",\"splay\":"<<(config.splay ? "true" : "false")
+       <<",\"hinted\":"<<(config.hinted ? "true" : "false")
+       <<",\"filter\":"<<config.filter
+       <<",\"misses\":"<<config.misses
+       <<",\"lazy\":"<<config.lazy
+       <<",\"size\":"<<config.size
+       <<",\"mix\":{\"insert\":"<<counts[INSERT]<<",\"lookup\":"<<counts[LOOKUP]
+       <<",\"remove\":"<<counts[REMOVE]<<",\"traverse\":"<<counts[TRAVERSE]<<"}"
+       <<",\"build_ns_per_op\":"<<(n ? buildNs / n : 0)
+       <<",\"build_ops_per_sec\":"<<(buildNs > 0 ? n * 1e9 / buildNs : 0)
+       <<",\"ops\":"<<ops
+       <<",\"ns_per_op\":"<<(ops ? opsNs / ops : 0)
+       <<",\"ops_per_sec\":"<<(opsNs > 0 ? ops * 1e9 / opsNs : 0)
+       <<",\"hits\":"<<hits
+       <<",\"final_size\":"<<tree.size()
+       <<",\"tombstones\":"<<tree.tombstoneCount()
+       <<",\"height\":"<<tree.height()
+       <<",\"peak_rss_kb\":"<<peakRssKb();
+   if (bursty)
+      json<<",\"remove_ns_per_op\":"<<(counts[REMOVE] ? removeNs / counts[REMOVE] : 0)
+          <<",\"removes_per_sec\":"<<(removeNs > 0 ? counts[REMOVE] * 1e9 / removeNs : 0);
+   if (config.filter > 0)
+   {
+      BstreeFilterStats filter = tree.filterStats();
+      json<<",\"filter_stats\":{\"bytes\":"<<filter.bytes<<",\"capacity\":"<<filter.capacity
+          <<",\"probes\":"<<filter.probes<<",\"queries\":"<<filter.queries
+          <<",\"rejects\":"<<filter.rejects<<",\"stale\":"<<filter.staleItems<<"}";
+   }
+   if (BstreeMetrics::enabled)
+   {
+      BstreeMetrics metrics = tree.metrics();
+      const char* names[BstreeMetrics::OPERATIONS] = {"search", "insert", "remove"};
+      json<<",\"metrics\":{";
+      for (int op = 0; op < BstreeMetrics::OPERATIONS; op++)
+         json<<"\""<<names[op]<<"\":{\"calls\":"<<metrics.calls[op]
+             <<",\"comparisons\":"<<metrics.comparisons[op]<<"},";
+      json<<"\"new\":"<<metrics.allocations<<",\"delete\":"<<metrics.deallocations
+          <<",\"parent_walks\":"<<metrics.parentWalks<<",\"parent_steps\":"<<metrics.parentSteps
+          <<",\"depths\":[";
+      for (int depth = 0; depth < BstreeMetrics::DEPTHS; depth++)
+         json<<(depth ? "," : "")<<metrics.depths[depth];
+      json<<"]}";
+   }
+   json<<"}";
+}
+
+int main(int argc, char** argv)
+{
+   vector<string> sizes = {"1e3", "1e4", "1e5", "1e6"};
+   vector<string> types = {"int", "string"};
+   vector<string> dists = {"sequential", "near-sequential", "random", "zipf", "sorted-delete",
+                           "burst-delete"};
+   BstreeBenchConfig config;
+   config.mix[0] = 20, config.mix[1] = 70, config.mix[2] = 10, config.mix[3] = 0;
+   config.seed = 42;
+   config.filter = config.misses = config.lazy = 0;
+   bool withSplay = false, withHinted = false;
+   long fixedOps = -1, maxDegenerate = 20000;
+   for (int i = 1; i < argc; i++)
+   {
+      string arg = argv[i];
+      string value = optionValue(arg);
+      if (arg.rfind("--sizes=", 0) == 0)
+         sizes = splitList(value);
+      else if (arg.rfind("--types=", 0) == 0)
+         types = splitList(value);
+      else if (arg.rfind("--dists=", 0) == 0)
+         dists = splitList(value);
+      else if (arg.rfind("--ops=", 0) == 0)
+         fixedOps = countValue(value);
+      else if (arg.rfind("--max-degenerate=", 0) == 0)
+         maxDegenerate = countValue(value);
+      else if (arg.rfind("--seed=", 0) == 0)
+         config.seed = strtoul(value.c_str(), nullptr, 10);
+      else if (arg == "--splay")
+         withSplay = true;
+      else if (arg == "--hinted")
+         withHinted = true;
+      else if (arg.rfind("--filter=", 0) == 0 && strtod(value.c_str(), nullptr) >= 0 &&
+               strtod(value.c_str(), nullptr) < 1)
+         config.filter = strtod(value.c_str(), nullptr);
+      else if (arg.rfind("--misses=", 0) == 0 && strtod(value.c_str(), nullptr) >= 0 &&
+               strtod(value.c_str(), nullptr) <= 1)
+         config.misses = strtod(value.c_str(), nullptr);
+      else if (arg.rfind("--lazy=", 0) == 0 && strtod(value.c_str(), nullptr) >= 0 &&
+               strtod(value.c_str(), nullptr) <= 1)
+         config.lazy = strtod(value.c_str(), nullptr);
+      else if (arg.rfind("--mix=", 0) == 0 &&
+               sscanf(value.c_str(), "%ld:%ld:%ld:%ld", &config.mix[0], &config.mix[1],
+                      &config.mix[2], &config.mix[3]) == 4)
+         continue;
+      else
+         exitWithUsage("bstree_bench [--sizes=1e3,1e4,...] [--types=int,string]"
+                       " [--dists=sequential,near-sequential,random,zipf,sorted-delete,burst-delete]"
+                       " [--mix=insert:lookup:remove:traverse] [--ops=N]"
+                       " [--max-degenerate=N] [--seed=N] [--splay] [--hinted]"
+                       " [--filter=rate] [--misses=fraction] [--lazy=fraction]");
+   }
+
+   JsonArray results(cout);
+   for (const string& type : types)
+      for (const string& dist : dists)
+         for (const string& size : sizes)
+            for (int variant = 0; variant < (withSplay ? 2 : 1) * (withHinted ? 2 : 1); variant++)
+            {
+               int splay = withSplay ? variant % 2 : 0;
+               int hinted = withHinted ? variant / (withSplay ? 2 : 1) : 0;
+               config.type = type;
+               config.dist = dist;
+               config.size = countValue(size);
+               config.ops = fixedOps >= 0 ? fixedOps : config.size;
+               config.splay = splay != 0;
+               config.hinted = hinted != 0;
+               results.next();
+               bool ascending = dist == "sequential" || dist == "near-sequential" || dist == "sorted-delete";
+               string header = "{\"type\":\""+type+"\",\"distribution\":\""+dist+"\""
+                  +",\"splay\":"+(config.splay ? "true" : "false")
+                  +",\"hinted\":"+(config.hinted ? "true" : "false")
+                  +",\"filter\":"+to_string(config.filter)
+                  +",\"misses\":"+to_string(config.misses)
+                  +",\"lazy\":"+to_string(config.lazy)
+                  +",\"size\":"+to_string(config.size);
+               if ((type != "int" && type != "string") ||
+                   (dist != "sequential" && dist != "near-sequential" && dist != "random" &&
+                    dist != "zipf" && dist != "sorted-delete" && dist != "burst-delete"))
+               {
+                  cout<<header<<",\"error\":\"unknown type or distribution\"}";
+                  continue;
+               }
+               if (ascending && config.size > maxDegenerate)
+               {
+                  cout<<header<<",\"skipped\":\"degenerate tree larger than --max-degenerate\"}";
+                  continue;
+               }
+               cout<<flush;
+               pid_t child = fork();
+               if (child == 0)
+               {
+                  if (type == "int")
+                     runBench<int>(config, cout);
+                  else
+                     runBench<string>(config, cout);
+                  cout<<flush;
+                  _exit(0);
+               }
+               int status = 0;
+               waitpid(child, &status, 0);
+               if (child < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                  cout<<header<<",\"error\":\"run failed\"}";
+            }
+   results.close();
+   return 0;
+}
@@ -4,133 +4,730 @@
  * @see Bstree
  * <pre>
  * File: BstreeParser.cpp
- * Parses a text file containing statement in the binary search tree 
+ * Parses a text file containing statement in the binary search tree
  * "language" that has the following grammar :-
  * trim: delete all leaf nodes from the tree and decrement it size accordingly
  * delete <item> : removes the specified item from the tree, if in the tree
  * insert <item> : insert the specified item in the tree or overwrite the
  *                 the item with the specified key if it is already in the tree
- * traverse: displays three lists in preorder, inorder, and postorder traversal 
+ * traverse: displays three lists in preorder, inorder, and postorder traversal
  *           of data this tree. one per line.
  * stats: displays the following information about this tree
  *        height = ?  size = ?
  *        #leaves = ?   #half-nodes = ?
  *        ?perfect = ?    ?balanced = ?
  *        minimum = ?     maximum = ?
+ *        and #tombstones = ? with --lazy,
+ *        followed by the state of the membership filter with --filter
+ *        and the operation counters of the tree when the program is
+ *        compiled with -DBSTREE_METRICS
+ * find <item> : tells whether the specified item is in the tree
+ * range <lo> <hi> : displays the items between lo and hi inclusive, in order
+ * rank <item> : displays the number of items in the tree less than item
+ * select <k> : displays the item with k smaller items in the tree
+ * min : displays the smallest item in the tree
+ * max : displays the largest item in the tree
+ * clear : deletes all the nodes from the tree
+ * bulkinsert <filename> : inserts every whitespace-delimited item in the
+ *                         specified file into the tree
+ *
+ * Usage: BstreeParser [--quiet] [--time] [--filter[=rate]] [--lazy[=fraction]]
+ *                     <Bstree-Prog-Filename>
+ * --quiet : only display the output of the traverse and stats statements
+ * --time : time every statement and display the 50th, 99th and 99.9th
+ *          percentile latency of each command after the last statement
+ * --filter : answer find and delete of absent items from a Bloom filter
+ *            with the specified false-positive rate, 0.01 by default
+ * --lazy : delete by leaving tombstones, and compact the tree once they are
+ *          more than the specified fraction of its nodes, 0.25 by default
+ *
+ * months.bst exercises the basic statements, queries.bst the queries,
+ * clear and bulkinsert (of seasons.txt, so run it from this directory)
+ * and lazy.bst the removals; lazy.bst must give the same answers and
+ * inorder traversals with and without --lazy, while its preorder and
+ * postorder traversals show where the tombstones and compaction leave the
+ * tree in another shape than eager deletion does.
+ *
+ * The program file is memory-mapped, or read whole if it is a pipe or
+ * FIFO, and tokenized in place; the output is collected in a large buffer
+ * that is written out only when it fills up.
  * </pre>
  */
 
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <iomanip>
 #include <cmath>
+#include <string_view>
+#include <map>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "Bstree.cpp"
 
 
 using namespace std;
 
+/**
+ * An output buffer that is written to the standard output in large blocks
+ */
+class OutBuffer
+{
+private:
+   /**
+    * the number of buffered bytes that triggers a write
+    */
+   static const size_t CAPACITY = 1 << 16;
+   /**
+    * the buffered output
+    */
+   string buffer;
+public:
+   /**
+    * Constructs an empty output buffer
+    */
+   OutBuffer()
+   {
+      buffer.reserve(2 * CAPACITY);
+   }
+   /**
+    * Writes the buffered output to the standard output
+    */
+   ~OutBuffer()
+   {
+      flush();
+   }
+   /**
+    * Appends the specified text to this buffer
+    * @param text the text to be appended
+    * @return this buffer
+    */
+   OutBuffer& operator<<(string_view text)
+   {
+      buffer.append(text.data(), text.size());
+      if (buffer.size() >= CAPACITY)
+         flush();
+      return *this;
+   }
+   /**
+    * Appends the specified character to this buffer
+    * @param ch the character to be appended
+    * @return this buffer
+    */
+   OutBuffer& operator<<(char ch)
+   {
+      buffer.push_back(ch);
+      if (buffer.size() >= CAPACITY)
+         flush();
+      return *this;
+   }
+   /**
+    * Appends the specified text left-justified in a field of the specified
+    * width; the same as cout<<left<<setw(width)<<text
+    * @param text the text to be appended
+    * @param width the minimum width of the field
+    * @return this buffer
+    */
+   OutBuffer& field(string_view text, size_t width)
+   {
+      *this<<text;
+      if (text.size() < width)
+         buffer.append(width - text.size(), ' ');
+      return *this;
+   }
+   /**
+    * Writes the buffered output to the standard output
+    */
+   void flush()
+   {
+      if (!buffer.empty())
+      {
+         fwrite(buffer.data(), 1, buffer.size(), stdout);
+         buffer.clear();
+      }
+      fflush(stdout);
+   }
+};
+
+/**
+ * A read-only memory mapping of a whole file; a pipe, FIFO or other file
+ * that cannot be mapped is read into memory instead
+ */
+class MappedFile
+{
+private:
+   /**
+    * the first byte of the file
+    */
+   const char* first;
+   /**
+    * the number of bytes in the file
+    */
+   size_t length;
+   /**
+    * whether the file was opened
+    */
+   bool opened;
+   /**
+    * whether first points to a mapping rather than into contents
+    */
+   bool mapped;
+   /**
+    * the bytes of a file that is not mapped
+    */
+   string contents;
+public:
+   /**
+    * Maps the specified file into memory, or reads it if it is not a
+    * regular file
+    * @param filename the name of the file to be mapped
+    */
+   MappedFile(const string& filename)
+   {
+      first = nullptr;
+      length = 0;
+      opened = false;
+      mapped = false;
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+         return;
+      struct stat info;
+      if (fstat(fd, &info) == 0)
+      {
+         opened = true;
+         /* a pipe or FIFO reports a size of 0 whatever it holds */
+         if (S_ISREG(info.st_mode) && info.st_size > 0)
+         {
+            void* addr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+               first = static_cast<const char*>(addr);
+               length = static_cast<size_t>(info.st_size);
+               mapped = true;
+               madvise(addr, length, MADV_SEQUENTIAL);
+            }
+         }
+         if (!mapped && !(S_ISREG(info.st_mode) && info.st_size == 0))
+         {
+            char buffer[65536];
+            ssize_t count;
+            while ((count = read(fd, buffer, sizeof(buffer))) > 0 || (count < 0 && errno == EINTR))
+               if (count > 0)
+                  contents.append(buffer, static_cast<size_t>(count));
+            opened = count == 0;
+            first = contents.data();
+            length = contents.size();
+         }
+      }
+      close(fd);
+   }
+   /**
+    * Unmaps the file
+    */
+   ~MappedFile()
+   {
+      if (mapped)
+         munmap(const_cast<char*>(first), length);
+   }
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+   /**
+    * Determines whether the file was opened and read
+    * @return true if the whole file is in memory; otherwise, false
+    */
+   bool isOpen() const
+   {
+      return opened;
+   }
+   /**
+    * Gives the first byte of the file
+    * @return the first byte of the file
+    */
+   const char* begin() const
+   {
+      return first;
+   }
+   /**
+    * Gives one past the last byte of the file
+    * @return one past the last byte of the file
+    */
+   const char* end() const
+   {
+      return first + length;
+   }
+};
+
+/**
+ * Determines whether the specified character separates tokens; the same
+ * characters that operator>> skips in the "C" locale
+ * @param ch a character
+ * @return true if ch is a whitespace character; otherwise, false
+ */
+inline bool isSeparator(char ch)
+{
+   return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+/**
+ * Extracts the next whitespace-delimited token without copying it
+ * @param pos the position to scan from; advanced past the token
+ * @param end one past the last character of the input
+ * @param token the extracted token
+ * @return true if a token is extracted; otherwise, false
+ */
+inline bool nextToken(const char*& pos, const char* end, string_view& token)
+{
+   while (pos < end && isSeparator(*pos))
+      pos++;
+   if (pos == end)
+      return false;
+   const char* start = pos;
+   while (pos < end && !isSeparator(*pos))
+      pos++;
+   token = string_view(start, pos - start);
+   return true;
+}
+
+/**
+ * A latency histogram with 16 logarithmic sub-buckets per power of two, so
+ * that every recorded value is kept to within 1/16 of its magnitude
+ */
+class LatencyHistogram
+{
+private:
+   /**
+    * the number of buckets needed to cover every 64-bit value
+    */
+   static const int BUCKETS = 61 * 16;
+   /**
+    * the number of values recorded in each bucket
+    */
+   unsigned long long counts[BUCKETS];
+   /**
+    * the number of recorded values
+    */
+   unsigned long long total;
+   /**
+    * the largest recorded value
+    */
+   unsigned long long largest;
+   /**
+    * Gives the bucket of the specified value
+    * @param value a recorded value
+    * @return the index of the bucket that counts value
+    */
+   static int bucketOf(unsigned long long value)
+   {
+      if (value < 16)
+         return static_cast<int>(value);
+      int msb = 63 - __builtin_clzll(value);
+      return (msb - 3) * 16 + static_cast<int>((value >> (msb - 4)) & 15);
+   }
+   /**
+    * Gives the largest value counted by the specified bucket
+    * @param bucket the index of a bucket
+    * @return the largest value that falls in the bucket
+    */
+   static unsigned long long upperBound(int bucket)
+   {
+      if (bucket < 16)
+         return bucket;
+      int shift = bucket / 16 - 1;
+      unsigned long long lower = static_cast<unsigned long long>(16 + bucket % 16) << shift;
+      return lower + (1ULL << shift) - 1;
+   }
+public:
+   /**
+    * Constructs an empty histogram
+    */
+   LatencyHistogram()
+   {
+      fill(counts, counts + BUCKETS, 0ULL);
+      total = 0;
+      largest = 0;
+   }
+   /**
+    * Records a value in this histogram
+    * @param value the value to be recorded
+    */
+   void record(unsigned long long value)
+   {
+      counts[bucketOf(value)]++;
+      total++;
+      largest = std::max(largest, value);
+   }
+   /**
+    * Gives the number of values recorded in this histogram
+    * @return the number of recorded values
+    */
+   unsigned long long count() const
+   {
+      return total;
+   }
+   /**
+    * Gives the largest recorded value
+    * @return the largest recorded value
+    */
+   unsigned long long maximum() const
+   {
+      return largest;
+   }
+   /**
+    * Gives an upper bound on the specified percentile of the recorded values
+    * @param fraction the percentile as a fraction between 0 and 1
+    * @return the largest value in the bucket holding the percentile
+    */
+   unsigned long long percentile(double fraction) const
+   {
+      unsigned long long rank = static_cast<unsigned long long>(ceil(fraction * total));
+      unsigned long long seen = 0;
+      for (int i = 0; i < BUCKETS; i++)
+      {
+         seen += counts[i];
+         if (seen >= rank && seen > 0)
+            return std::min(upperBound(i), largest);
+      }
+      return largest;
+   }
+};
+
+/**
+ * the program output
+ */
+OutBuffer out;
+
 /**
  * Displays a string and advances the cursor to the next line
  * @param word the string to be displayed
  */
 void printWord(const string& word)
 {
-   cout<<word<<endl;
+   out<<word<<'\n';
+}
+
+/**
+ * Displays the latency percentiles of every command that was timed
+ * @param latencies the latency histogram of each command
+ */
+void printLatencies(const map<string, LatencyHistogram, less<>>& latencies)
+{
+   out<<'\n'<<"***Latency (ns)***"<<'\n';
+   out.field("command", 12).field("count", 12).field("p50", 12)
+      .field("p99", 12).field("p999", 12).field("max", 12)<<'\n';
+   for (const auto& entry : latencies)
+   {
+      const LatencyHistogram& histogram = entry.second;
+      out.field(entry.first, 12)
+         .field(to_string(histogram.count()), 12)
+         .field(to_string(histogram.percentile(0.50)), 12)
+         .field(to_string(histogram.percentile(0.99)), 12)
+         .field(to_string(histogram.percentile(0.999)), 12)
+         .field(to_string(histogram.maximum()), 12)<<'\n';
+   }
+   out<<'\n';
+}
+
+/**
+ * Displays the operation counters of a tree
+ * @param metrics a snapshot of the operation counters of a tree
+ */
+void printMetrics(const BstreeMetrics& metrics)
+{
+   const char* names[BstreeMetrics::OPERATIONS] = {"searches", "inserts", "removes"};
+   char average[32];
+   out<<"***Metrics***"<<'\n';
+   for (int op = 0; op < BstreeMetrics::OPERATIONS; op++)
+   {
+      long calls = metrics.calls[op];
+      snprintf(average, sizeof(average), "%.2f",
+               calls ? static_cast<double>(metrics.comparisons[op]) / calls : 0.0);
+      out.field(string("#")+names[op]+" = "+to_string(calls), 20)
+         .field("comparisons = "+to_string(metrics.comparisons[op]), 30)
+         .field(string("avg = ")+average, 20)<<'\n';
+   }
+   out.field("#new = "+to_string(metrics.allocations), 20)
+      .field("#delete = "+to_string(metrics.deallocations), 20)<<'\n';
+   out.field("#parent walks = "+to_string(metrics.parentWalks), 30)
+      .field("parent steps = "+to_string(metrics.parentSteps), 20)<<'\n';
+   out<<"descent depths =";
+   for (int depth = 0; depth < BstreeMetrics::DEPTHS; depth++)
+      if (metrics.depths[depth])
+         out<<' '<<to_string(depth)<<(depth == BstreeMetrics::DEPTHS - 1 ? "+:" : ":")
+            <<to_string(metrics.depths[depth]);
+   out<<'\n'<<'\n';
+}
+
+/**
+ * Displays the state of the membership filter of a tree
+ * @param stats a snapshot of the membership filter of a tree
+ */
+void printFilter(const BstreeFilterStats& stats)
+{
+   char rejected[32];
+   snprintf(rejected, sizeof(rejected), "%.1f%%",
+            stats.queries ? 100.0 * stats.rejects / stats.queries : 0.0);
+   out<<"***Filter***"<<'\n';
+   out.field("bytes = "+to_string(stats.bytes), 20)
+      .field("capacity = "+to_string(stats.capacity), 20)
+      .field("probes = "+to_string(stats.probes), 20)<<'\n';
+   out.field("#queries = "+to_string(stats.queries), 20)
+      .field("#rejects = "+to_string(stats.rejects)+" ("+rejected+")", 30)
+      .field("stale = "+to_string(stats.staleItems), 20)<<'\n'<<'\n';
 }
 
 int main(int argc, char** argv)
 {
    try
    {
-      if (argc != 2)
+      bool quiet = false, timed = false, badUsage = false;
+      double filterRate = 0, tombstoneLimit = 0;
+      string filename;
+      for (int i = 1; i < argc; i++)
       {
-          cerr<<"Usage: BstreeParser <Bstree-Prog-Filename>"<<endl;
+         if (strcmp(argv[i], "--quiet") == 0)
+            quiet = true;
+         else if (strcmp(argv[i], "--time") == 0)
+            timed = true;
+         else if (strcmp(argv[i], "--filter") == 0)
+            filterRate = 0.01;
+         else if (strncmp(argv[i], "--filter=", 9) == 0)
+         {
+            filterRate = atof(argv[i] + 9);
+            badUsage = badUsage || !(filterRate > 0 && filterRate < 1);
+         }
+         else if (strcmp(argv[i], "--lazy") == 0)
+            tombstoneLimit = 0.25;
+         else if (strncmp(argv[i], "--lazy=", 7) == 0)
+         {
+            tombstoneLimit = atof(argv[i] + 7);
+            badUsage = badUsage || !(tombstoneLimit > 0 && tombstoneLimit <= 1);
+         }
+         else if (filename.empty())
+            filename = argv[i];
+         else
+            badUsage = true;
+      }
+      if (badUsage || filename.empty())
+      {
+          cerr<<"Usage: BstreeParser [--quiet] [--time] [--filter[=rate]] [--lazy[=fraction]]"
+              <<" <Bstree-Prog-Filename>"<<endl;
           exit(1);
       }
-      string filename = argv[1];
-      fstream inFile;
-      inFile.open(filename.c_str(),ios::in);
-      if (!inFile)
+      MappedFile inFile(filename);
+      if (!inFile.isOpen())
       {
          cerr<<"Unable to open "<<filename<<" for input."<<endl;
          exit(2);
       }
-      string cmd, token;
+      const char* pos = inFile.begin();
+      const char* end = inFile.end();
+      string_view cmd, token;
+      string item, hiItem;
       Bstree<string> words;
-      while (inFile>>cmd)
+      if (filterRate > 0)
+         words.setFilter(filterRate);
+      words.setLazyDeletion(tombstoneLimit);
+      map<string, LatencyHistogram, less<>> latencies;
+      chrono::steady_clock::time_point started;
+      while (nextToken(pos, end, cmd))
       {
+         if (timed)
+            started = chrono::steady_clock::now();
          if (cmd == "trim")
          {
             words.trim();
-            cout<<"leaf nodes deleted"<<endl;
-            cout<<endl;
+            if (!quiet)
+               out<<"leaf nodes deleted\n\n";
          }
          else if (cmd == "delete")
          {
-            inFile>>token;
-            words.remove(token);
-            cout<<"deleted "<<token<<endl;
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            item.assign(token.data(), token.size());
+            words.remove(item);
+            if (!quiet)
+               out<<"deleted "<<token<<'\n';
          }
          else if (cmd == "insert")
          {
-            inFile>>token;
-            words.insert(token);
-            cout<<"inserted "<<token<<endl;
-         }    
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            words.insert(string(token));
+            if (!quiet)
+               out<<"inserted "<<token<<'\n';
+         }
+         else if (cmd == "find")
+         {
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            item.assign(token.data(), token.size());
+            bool found = words.inTree(item);
+            if (!quiet)
+               out<<(found ? "found " : "did not find ")<<token<<'\n';
+         }
+         else if (cmd == "range")
+         {
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            item.assign(token.data(), token.size());
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            hiItem.assign(token.data(), token.size());
+            if (quiet)
+               words.rangeTraverse(item, hiItem, [](const string&) {});
+            else
+            {
+               out<<"range "<<item<<' '<<hiItem<<'\n';
+               out<<"--------------------------------------"<<'\n';
+               words.rangeTraverse(item, hiItem, printWord);
+               out<<"--------------------------------------"<<'\n';
+            }
+         }
+         else if (cmd == "rank")
+         {
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            item.assign(token.data(), token.size());
+            long itemRank = words.rank(item);
+            if (!quiet)
+               out<<"rank "<<token<<" = "<<to_string(itemRank)<<'\n';
+         }
+         else if (cmd == "select")
+         {
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            long k = atol(string(token).c_str());
+            if (k < 0 || k >= words.size())
+            {
+               if (!quiet)
+                  out<<"select "<<token<<" = UNDEFINED"<<'\n';
+            }
+            else
+            {
+               const string& selected = words.select(k);
+               if (!quiet)
+                  out<<"select "<<token<<" = "<<selected<<'\n';
+            }
+         }
+         else if (cmd == "min" || cmd == "max")
+         {
+            bool isMin = cmd == "min";
+            string_view label = isMin ? "minimum = " : "maximum = ";
+            if (words.empty())
+            {
+               if (!quiet)
+                  out<<label<<"UNDEFINED"<<'\n';
+            }
+            else
+            {
+               const string& extreme = isMin ? words.min() : words.max();
+               if (!quiet)
+                  out<<label<<extreme<<'\n';
+            }
+         }
+         else if (cmd == "clear")
+         {
+            words.clear();
+            if (!quiet)
+               out<<"all nodes deleted\n\n";
+         }
+         else if (cmd == "bulkinsert")
+         {
+            if (!nextToken(pos, end, token))
+               token = string_view();
+            string bulkname(token);
+            MappedFile bulkFile(bulkname);
+            if (!bulkFile.isOpen())
+               throw BstreeException("Unable to open "+bulkname+" for input.");
+            const char* bulkPos = bulkFile.begin();
+            string_view bulkItem;
+            long inserted = 0;
+            while (nextToken(bulkPos, bulkFile.end(), bulkItem))
+            {
+               words.insert(string(bulkItem));
+               inserted++;
+            }
+            if (!quiet)
+               out<<"inserted "<<to_string(inserted)<<" items from "<<bulkname<<'\n';
+         }
          else if (cmd == "traverse")
          {
-            cout<<endl<<"***Traversals***"<<endl;
-            cout<<"======================================"<<endl;
-            cout<<"Preorder Traversal"<<endl;
-            cout<<"--------------------------------------"<<endl;
+            out<<'\n'<<"***Traversals***"<<'\n';
+            out<<"======================================"<<'\n';
+            out<<"Preorder Traversal"<<'\n';
+            out<<"--------------------------------------"<<'\n';
             words.preorderTraverse(printWord);
-            cout<<"--------------------------------------"<<endl;
-            cout<<"Inorder Traversal"<<endl;
-            cout<<"--------------------------------------"<<endl;
+            out<<"--------------------------------------"<<'\n';
+            out<<"Inorder Traversal"<<'\n';
+            out<<"--------------------------------------"<<'\n';
             words.inorderTraverse(printWord);
-            cout<<"--------------------------------------"<<endl;
-            cout<<"Postorder Traversal"<<endl;
-            cout<<"--------------------------------------"<<endl;
+            out<<"--------------------------------------"<<'\n';
+            out<<"Postorder Traversal"<<'\n';
+            out<<"--------------------------------------"<<'\n';
             words.postorderTraverse(printWord);
-            cout<<"--------------------------------------"<<endl;
-            cout<<endl;
-         }       
+            out<<"--------------------------------------"<<'\n';
+            out<<'\n';
+         }
          else if (cmd == "stats")
          {
-            cout<<endl<<"***Statistics/Information***"<<endl;
+            out<<'\n'<<"***Statistics/Information***"<<'\n';
             long treeHeight = words.height();
             long treeSize = words.size();
             long halfCount = words.countHalves();
             string label1 = "?perfect = ", label2 = "?balanced = ";
-            bool isPerfect = treeSize == static_cast<long>(pow(2,treeHeight+1))-1;
-            cout<<left<<setw(20)<<"height = "+to_string(treeHeight)
-                <<left<<setw(20)<<"size = "+to_string(treeSize)<<endl;
-            cout<<left<<setw(20)<<"#leaves = "+to_string(words.countLeaves())
-                <<left<<setw(20)<<"#halves-nodes = "+to_string(halfCount)<<endl;
+            /* the height counts the nodes of the tombstones too */
+            long nodeCount = treeSize + words.tombstoneCount();
+            bool isPerfect = nodeCount == static_cast<long>(pow(2,treeHeight+1))-1;
+            out.field("height = "+to_string(treeHeight), 20)
+               .field("size = "+to_string(treeSize), 20)<<'\n';
+            out.field("#leaves = "+to_string(words.countLeaves()), 20)
+               .field("#halves-nodes = "+to_string(halfCount), 20)<<'\n';
+            if (tombstoneLimit > 0)
+               out.field("#tombstones = "+to_string(words.tombstoneCount()), 20)<<'\n';
             if (words.empty())
             {
-               cout<<left<<setw(20)<<"minimum = UNDEFINED"
-               <<left<<setw(20)<<"maximum = UNDEFINED"<<endl;
+               out.field("minimum = UNDEFINED", 20)
+                  .field("maximum = UNDEFINED", 20)<<'\n';
             }
             else
             {
-               cout<<left<<setw(20)<<"minimum = "+words.min()
-                <<left<<setw(20)<<"maximum = "+words.max()<<endl;
+               out.field("minimum = "+words.min(), 20)
+                  .field("maximum = "+words.max(), 20)<<'\n';
             }
-            cout<<left<<setw(20)<<label1+(isPerfect ? "true" : "false")
-                <<left<<setw(20)<<label2+(words.isBalanced() ? "true" : "false")<<endl<<endl;
-         }    
+            out.field(label1+(isPerfect ? "true" : "false"), 20)
+               .field(label2+(words.isBalanced() ? "true" : "false"), 20)<<'\n'<<'\n';
+            if (filterRate > 0)
+               printFilter(words.filterStats());
+            if (BstreeMetrics::enabled)
+               printMetrics(words.metrics());
+         }
          else
          {
             throw BstreeException(filename+" parsing error");
          }
+         if (timed)
+         {
+            auto elapsed = chrono::steady_clock::now() - started;
+            auto verb = latencies.find(cmd);
+            if (verb == latencies.end())
+               verb = latencies.emplace(string(cmd), LatencyHistogram()).first;
+            verb->second.record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+         }
       }
+      if (timed)
+         printLatencies(latencies);
    }
    catch(const BstreeException& e)
    {
+      out.flush();
       cerr<<e.what()<<endl;
    }
+   out.flush();
    return 0;
 }
-
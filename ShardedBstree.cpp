@@ -0,0 +1,443 @@
+/**
+ * Implementation file for function of the ShardedBstree<T> class
+ * @author ketsubetsu
+ * @see ShardedBstree.h
+ * <pre>
+ * File: ShardedBstree.cpp
+ * </pre>
+ */
+
+using namespace std;
+
+#include "ShardedBstree.h"
+
+template <typename T>
+ShardedBstree<T>::ShardedBstree(long count, const vector<T>& sample)
+{
+   if (count < 1)
+      throw BstreeException("Exception: a sharded tree needs at least one shard.");
+   rebalanceCount = 0;
+   imbalance = 2.0;
+   for (long i = 0; i < count; i++)
+   {
+      shards.push_back(unique_ptr<Shard>(new Shard));
+      shards.back()->version = 0;
+      shards.back()->count = 0;
+      shards.back()->sinceCheck = 0;
+   }
+   vector<T> sorted(sample);
+   sort(sorted.begin(), sorted.end(), [](const T& a, const T& b) { return b > a; });
+   sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+   /* one range per shard while the sample has enough distinct keys */
+   unique_ptr<Layout> first(new Layout);
+   first->version = 0;
+   first->owners.push_back(0);
+   size_t n = sorted.size(), p = shards.size(), previous = 0;
+   for (size_t i = 1; i < p; i++)
+   {
+      size_t index = i * n / p;
+      if (index > previous)
+      {
+         first->bounds.push_back(sorted[index]);
+         first->owners.push_back(first->owners.size());
+         previous = index;
+      }
+   }
+   publish(std::move(first));
+}
+
+template <typename T>
+size_t ShardedBstree<T>::locate(const Layout* current, const T& key)
+{
+   /* the number of bounds not greater than key */
+   size_t lo = 0, hi = current->bounds.size();
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+      if (current->bounds[mid] > key)
+         hi = mid;
+      else
+         lo = mid + 1;
+   }
+   return lo;
+}
+
+template <typename T>
+typename ShardedBstree<T>::Shard& ShardedBstree<T>::lockShard(const T& key) const
+{
+   while (true)
+   {
+      shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+      Shard& shard = *shards[current->owners[locate(current.get(), key)]];
+      shard.lock.lock();
+      if (shard.version <= current->version)
+         return shard;
+      /* its range changed while waiting; the key may belong to another shard now */
+      shard.lock.unlock();
+   }
+}
+
+template <typename T>
+vector<unique_lock<mutex>> ShardedBstree<T>::lockAll() const
+{
+   vector<unique_lock<mutex>> locks;
+   locks.reserve(shards.size());
+   for (const unique_ptr<Shard>& shard : shards)
+      locks.emplace_back(shard->lock);
+   return locks;
+}
+
+template <typename T>
+void ShardedBstree<T>::publish(unique_ptr<Layout> next)
+{
+   atomic_store_explicit(&layout, shared_ptr<const Layout>(std::move(next)), memory_order_release);
+}
+
+template <typename T>
+void ShardedBstree<T>::checkBalance(const Shard& shard)
+{
+   double factor = imbalance.load(memory_order_relaxed);
+   if (factor == 0)
+      return;
+   unique_lock<mutex> guard(rebalancing, try_to_lock);
+   if (!guard.owns_lock())
+      return; /* another thread is rebalancing */
+   /* only the holder of the rebalancing lock publishes layouts */
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_relaxed);
+   size_t ranges = current->owners.size(), hot = ranges;
+   long total = 0;
+   for (size_t r = 0; r < ranges; r++)
+   {
+      const Shard& owner = *shards[current->owners[r]];
+      total += owner.count.load(memory_order_relaxed);
+      if (&owner == &shard)
+         hot = r;
+   }
+   if (hot == ranges)
+      return; /* merged away since the insert */
+   long mine = shard.count.load(memory_order_relaxed);
+   long others = static_cast<long>(ranges) - 1;
+   /* small trees are not worth the pause; until every shard has a range,
+    * any shard past that is split to spread the threads */
+   if (mine > 64 && (ranges < shards.size() || mine > factor * (total - mine) / others))
+      offload(hot);
+}
+
+template <typename T>
+void ShardedBstree<T>::offload(size_t hot)
+{
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_relaxed);
+   size_t ranges = current->owners.size();
+   vector<bool> owned(shards.size(), false);
+   for (size_t owner : current->owners)
+      owned[owner] = true;
+   size_t spare = find(owned.begin(), owned.end(), false) - owned.begin();
+   /* the first of two neighbouring ranges to be merged, if any */
+   size_t merge = ranges;
+   /* the neighbour that takes part of the range instead, if any */
+   size_t side = ranges;
+   if (spare == shards.size())
+   {
+      /* merging is only worth it if the result is smaller than the hot shard */
+      long least = shards[current->owners[hot]]->count.load(memory_order_relaxed);
+      for (size_t r = 0; r + 1 < ranges; r++)
+      {
+         if (r == hot || r + 1 == hot)
+            continue;
+         long sum = shards[current->owners[r]]->count.load(memory_order_relaxed) +
+                    shards[current->owners[r + 1]]->count.load(memory_order_relaxed);
+         if (sum < least)
+         {
+            least = sum;
+            merge = r;
+         }
+      }
+      if (merge < ranges)
+         spare = current->owners[merge + 1];
+      else if (ranges == 1)
+         return;
+      else if (hot == 0 || (hot + 1 < ranges &&
+               shards[current->owners[hot + 1]]->count.load(memory_order_relaxed) <
+               shards[current->owners[hot - 1]]->count.load(memory_order_relaxed)))
+         side = hot + 1;
+      else
+         side = hot - 1;
+   }
+
+   vector<size_t> involved = {current->owners[hot]};
+   if (side < ranges)
+      involved.push_back(current->owners[side]);
+   else
+      involved.push_back(spare);
+   if (merge < ranges)
+      involved.push_back(current->owners[merge]);
+   sort(involved.begin(), involved.end());
+   vector<unique_lock<mutex>> locks;
+   for (size_t index : involved)
+      locks.emplace_back(shards[index]->lock);
+   if (merge == ranges && shards[current->owners[hot]]->tree.size() < 2)
+      return; /* emptied since the check */
+
+   unique_ptr<Layout> next(new Layout(*current));
+   next->version = current->version + 1;
+   if (side < ranges)
+   {
+      /* move the boundary so that both ranges hold half of their items */
+      Shard& from = *shards[current->owners[hot]];
+      Shard& to = *shards[current->owners[side]];
+      long half = (from.tree.size() + to.tree.size()) / 2;
+      long keep = side > hot ? half : from.tree.size() - (half - to.tree.size());
+      if (keep <= 0 || keep >= from.tree.size())
+         return; /* the neighbour grew since the check */
+      from.tree.balance();
+      T bound = from.tree.select(side > hot ? keep : from.tree.size() - keep);
+      pair<Bstree<T>, Bstree<T>> halves = from.tree.split(bound);
+      if (side > hot)
+      {
+         halves.second.join(to.tree);
+         from.tree = std::move(halves.first);
+         to.tree = std::move(halves.second);
+         next->bounds[hot] = bound;
+      }
+      else
+      {
+         to.tree.join(halves.first);
+         from.tree = std::move(halves.second);
+         next->bounds[side] = bound;
+      }
+      from.count.store(from.tree.size(), memory_order_relaxed);
+      to.count.store(to.tree.size(), memory_order_relaxed);
+      from.version = to.version = next->version;
+      from.sinceCheck = to.sinceCheck = 0;
+      publish(std::move(next));
+      rebalanceCount++;
+      return;
+   }
+   if (merge < ranges)
+   {
+      Shard& lower = *shards[current->owners[merge]];
+      lower.tree.join(shards[spare]->tree);
+      lower.count.store(lower.tree.size(), memory_order_relaxed);
+      lower.version = next->version;
+      next->bounds.erase(next->bounds.begin() + merge);
+      next->owners.erase(next->owners.begin() + merge + 1);
+      if (hot > merge)
+         hot--;
+   }
+   Shard& from = *shards[next->owners[hot]];
+   Shard& to = *shards[spare];
+   to.version = next->version;
+   if (from.tree.size() >= 2)
+   {
+      /* balanced first, the median is near the root and the split is short */
+      from.tree.balance();
+      T median = from.tree.select(from.tree.size() / 2);
+      pair<Bstree<T>, Bstree<T>> halves = from.tree.split(median);
+      from.tree = std::move(halves.first);
+      to.tree = std::move(halves.second);
+      from.count.store(from.tree.size(), memory_order_relaxed);
+      to.count.store(to.tree.size(), memory_order_relaxed);
+      from.version = next->version;
+      next->bounds.insert(next->bounds.begin() + hot, median);
+      next->owners.insert(next->owners.begin() + hot + 1, spare);
+   }
+   from.sinceCheck = to.sinceCheck = 0;
+   publish(std::move(next));
+   rebalanceCount++;
+}
+
+template <typename T>
+void ShardedBstree<T>::redistribute()
+{
+   vector<unique_lock<mutex>> locks = lockAll();
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_relaxed);
+   /* the ranges are in key order, so each join only appends */
+   Bstree<T> items;
+   for (size_t owner : current->owners)
+      items.join(shards[owner]->tree);
+   items.balance();
+   unique_ptr<Layout> next(new Layout);
+   next->version = current->version + 1;
+   long n = items.size(), p = static_cast<long>(shards.size()), taken = 0;
+   for (long i = 1; i < p; i++)
+   {
+      long index = i * n / p;
+      if (index > taken)
+      {
+         T bound = items.select(index - taken);
+         pair<Bstree<T>, Bstree<T>> halves = items.split(bound);
+         shards[next->owners.size()]->tree = std::move(halves.first);
+         items = std::move(halves.second);
+         next->bounds.push_back(bound);
+         next->owners.push_back(next->owners.size());
+         taken = index;
+      }
+   }
+   shards[next->owners.size()]->tree = std::move(items);
+   next->owners.push_back(next->owners.size());
+   for (const unique_ptr<Shard>& shard : shards)
+   {
+      shard->tree.balance();
+      shard->count.store(shard->tree.size(), memory_order_relaxed);
+      shard->version = next->version;
+      shard->sinceCheck = 0;
+   }
+   publish(std::move(next));
+   rebalanceCount++;
+}
+
+template <typename T>
+bool ShardedBstree<T>::empty() const
+{
+   return size() == 0;
+}
+
+template <typename T>
+long ShardedBstree<T>::size() const
+{
+   long total = 0;
+   for (const unique_ptr<Shard>& shard : shards)
+      total += shard->count.load(memory_order_relaxed);
+   return total;
+}
+
+template <typename T>
+long ShardedBstree<T>::shardCount() const
+{
+   return static_cast<long>(shards.size());
+}
+
+template <typename T>
+void ShardedBstree<T>::insert(T item)
+{
+   Shard& shard = lockShard(item);
+   bool check;
+   {
+      lock_guard<mutex> guard(shard.lock, adopt_lock);
+      shard.tree.insert(std::move(item));
+      shard.count.store(shard.tree.size(), memory_order_relaxed);
+      check = ++shard.sinceCheck >= 1024;
+      if (check)
+         shard.sinceCheck = 0;
+   }
+   if (check)
+      checkBalance(shard);
+}
+
+template <typename T>
+bool ShardedBstree<T>::inTree(const T& item) const
+{
+   Shard& shard = lockShard(item);
+   lock_guard<mutex> guard(shard.lock, adopt_lock);
+   return shard.tree.inTree(item);
+}
+
+template <typename T>
+bool ShardedBstree<T>::remove(const T& item)
+{
+   Shard& shard = lockShard(item);
+   lock_guard<mutex> guard(shard.lock, adopt_lock);
+   bool removed = shard.tree.remove(item);
+   shard.count.store(shard.tree.size(), memory_order_relaxed);
+   return removed;
+}
+
+template <typename T>
+T ShardedBstree<T>::retrieve(const T& key) const
+{
+   Shard& shard = lockShard(key);
+   lock_guard<mutex> guard(shard.lock, adopt_lock);
+   return shard.tree.retrieve(key);
+}
+
+template <typename T>
+T ShardedBstree<T>::min() const
+{
+   vector<unique_lock<mutex>> locks = lockAll();
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+   for (size_t owner : current->owners)
+      if (!shards[owner]->tree.empty())
+         return shards[owner]->tree.min();
+   throw BstreeException("Tree is empty");
+}
+
+template <typename T>
+T ShardedBstree<T>::max() const
+{
+   vector<unique_lock<mutex>> locks = lockAll();
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+   for (size_t r = current->owners.size(); r > 0; r--)
+      if (!shards[current->owners[r - 1]]->tree.empty())
+         return shards[current->owners[r - 1]]->tree.max();
+   throw BstreeException("Tree is empty");
+}
+
+template <typename T>
+void ShardedBstree<T>::inorderTraverse(FuncType apply) const
+{
+   vector<unique_lock<mutex>> locks = lockAll();
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+   for (size_t owner : current->owners)
+      shards[owner]->tree.inorderTraverse(apply);
+}
+
+template <typename T>
+void ShardedBstree<T>::rebalance()
+{
+   lock_guard<mutex> guard(rebalancing);
+   redistribute();
+}
+
+template <typename T>
+void ShardedBstree<T>::setAutoRebalance(double factor)
+{
+   if (!(factor == 0 || factor > 1))
+      throw BstreeException("Exception: imbalance factor out of range on setAutoRebalance().");
+   imbalance.store(factor, memory_order_relaxed);
+}
+
+template <typename T>
+vector<long> ShardedBstree<T>::shardSizes() const
+{
+   vector<long> sizes;
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+   for (size_t owner : current->owners)
+      sizes.push_back(shards[owner]->count.load(memory_order_relaxed));
+   return sizes;
+}
+
+template <typename T>
+ShardedBstreeStats ShardedBstree<T>::stats() const
+{
+   ShardedBstreeStats stats;
+   lock_guard<mutex> pause(rebalancing);
+   shared_ptr<const Layout> current = atomic_load_explicit(&layout, memory_order_acquire);
+   stats.shards = static_cast<long>(current->owners.size());
+   stats.minShard = -1;
+   stats.rebalances = rebalanceCount.load(memory_order_relaxed);
+   for (size_t owner : current->owners)
+   {
+      lock_guard<mutex> guard(shards[owner]->lock);
+      const Bstree<T>& tree = shards[owner]->tree;
+      long size = tree.size();
+      stats.size += size;
+      stats.minShard = stats.minShard < 0 ? size : std::min(stats.minShard, size);
+      stats.maxShard = std::max(stats.maxShard, size);
+      stats.height = std::max(stats.height, tree.height());
+      stats.leaves += tree.countLeaves();
+      stats.halves += tree.countHalves();
+      BstreeMetrics metrics = tree.metrics();
+      for (int op = 0; op < BstreeMetrics::OPERATIONS; op++)
+      {
+         stats.metrics.calls[op] += metrics.calls[op];
+         stats.metrics.comparisons[op] += metrics.comparisons[op];
+      }
+      for (int depth = 0; depth < BstreeMetrics::DEPTHS; depth++)
+         stats.metrics.depths[depth] += metrics.depths[depth];
+      stats.metrics.allocations += metrics.allocations;
+      stats.metrics.deallocations += metrics.deallocations;
+      stats.metrics.parentWalks += metrics.parentWalks;
+      stats.metrics.parentSteps += metrics.parentSteps;
+   }
+   return stats;
+}
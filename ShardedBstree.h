@@ -0,0 +1,330 @@
+/**
+ * The specification for a binary search tree that is partitioned by key
+ * range into independently locked shards, for use by many threads.
+ * @author ketsubetsu
+ * <pre>
+ * File: ShardedBstree.h
+ * </pre>
+ */
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Bstree.h"
+
+#ifndef SHARDED_BSTREE_H
+#define SHARDED_BSTREE_H
+
+using namespace std;
+
+/**
+ * A snapshot of the sizes and shapes of the shards of a ShardedBstree
+ */
+struct ShardedBstreeStats
+{
+   /**
+    * the number of items in all the shards
+    */
+   long size;
+   /**
+    * the number of shards that hold a range of keys
+    */
+   long shards;
+   /**
+    * the number of items in the smallest and in the largest shard
+    */
+   long minShard, maxShard;
+   /**
+    * the height of the tallest shard
+    */
+   long height;
+   /**
+    * the number of leaf nodes and half nodes in all the shards
+    */
+   long leaves, halves;
+   /**
+    * the number of times the shard boundaries have been changed after
+    * construction
+    */
+   long rebalances;
+   /**
+    * the sum of the operation counters of the shards
+    */
+   BstreeMetrics metrics;
+   /**
+    * Constructs a snapshot of an empty tree
+    */
+   ShardedBstreeStats()
+   {
+      size = shards = minShard = maxShard = leaves = halves = rebalances = 0;
+      height = -1;
+   }
+};
+
+/**
+ * A set of items kept in up to P Bstree shards, each holding the items in
+ * one range of keys, so that threads working on different ranges never
+ * wait for each other. Every operation on an item locks only the shard of
+ * its key. The boundaries between the ranges start at the quantiles of a
+ * sample given to the constructor. When a shard grows well beyond the
+ * others, its range is split at its median and the upper half of its
+ * nodes is moved to a shard without a range, which may first be freed by
+ * merging the two smallest neighbouring shards, or else its boundary with
+ * a neighbour moves; only the shards involved are locked, and nodes are
+ * relinked rather than copied.
+ * Programs include Bstree.cpp and then ShardedBstree.cpp, and link with
+ * -pthread.
+ * @param <T> the data type of the items; copyable, with == and >
+ */
+template <typename T>
+class ShardedBstree
+{
+private:
+   /**
+    * forward declaration of a function pointer of type (const T&) -> void
+    */
+   typedef void (*FuncType)(const T& item);
+   /**
+    * The ranges of keys and the shards that own them; range r holds the
+    * items k with bounds[r - 1] <= k and bounds[r] > k, and belongs to
+    * shards[owners[r]]. A layout is never changed once published, so it
+    * can be searched without a lock.
+    */
+   struct Layout
+   {
+      vector<T> bounds;
+      vector<size_t> owners;
+      /**
+       * one more than the version of the layout it replaced
+       */
+      long version;
+   };
+   /**
+    * A shard, on cache lines of its own so that the locks of neighbouring
+    * shards do not share a line
+    */
+   struct alignas(64) Shard
+   {
+      /**
+       * the lock that guards every other member of this shard
+       */
+      mutex lock;
+      /**
+       * the items of this shard
+       */
+      Bstree<T> tree;
+      /**
+       * the version of the layout that last changed the range of this
+       * shard; an operation that found this shard through an older layout
+       * must look again
+       */
+      long version;
+      /**
+       * the number of items in this shard, readable without the lock
+       */
+      atomic<long> count;
+      /**
+       * the number of inserts since the balance of the shards was checked
+       */
+      long sinceCheck;
+   };
+   /**
+    * the shards of this tree
+    */
+   vector<unique_ptr<Shard>> shards;
+   /**
+    * the layout of the shards, only read and replaced with atomic_load
+    * and atomic_store; a thread holds a copy while it reads a layout, so
+    * an old layout is freed once no thread still reads it
+    */
+   shared_ptr<const Layout> layout;
+   /**
+    * held by the thread that rebalances, so that others need not wait,
+    * and by stats, so that the layout stays put while it runs
+    */
+   mutable mutex rebalancing;
+   /**
+    * the number of times the layout changed after construction
+    */
+   atomic<long> rebalanceCount;
+   /**
+    * how much larger than the average of the other shards a shard may
+    * grow before a rebalance; 0 if the boundaries are never changed
+    * automatically
+    */
+   atomic<double> imbalance;
+   /**
+    * Gives the index of the range that holds the specified key
+    * @param current a layout of this tree
+    * @param key the search key
+    * @return the index of the range of key in the layout
+    */
+   static size_t locate(const Layout* current, const T& key);
+   /**
+    * Locks the shard of the specified key, looking again if the layout
+    * changes while waiting for the lock
+    * @param key the search key
+    * @return the locked shard of key
+    */
+   Shard& lockShard(const T& key) const;
+   /**
+    * Locks every shard, in index order so that two threads doing so cannot
+    * deadlock
+    * @return the locks of the shards
+    */
+   vector<unique_lock<mutex>> lockAll() const;
+   /**
+    * Makes the specified layout the current one; the shards whose range
+    * it changes must be locked, or the tree not yet shared
+    * @param next the new layout
+    */
+   void publish(unique_ptr<Layout> next);
+   /**
+    * Offloads a range if some shard has no range yet or if its shard
+    * holds more items than the average of the other shards times the
+    * imbalance factor
+    * @param shard a shard that is not locked by this thread
+    */
+   void checkBalance(const Shard& shard);
+   /**
+    * Moves the upper half of the items of a range to a shard without a
+    * range, merging the two neighbouring ranges with the fewest items
+    * first if every shard has one. If no two other ranges hold fewer items
+    * than it, its boundary with its smaller neighbour moves instead so
+    * that the two hold as many items. The caller must hold the
+    * rebalancing lock.
+    * @param hot the index of the overloaded range in the current layout
+    */
+   void offload(size_t hot);
+   /**
+    * Moves the items to the shards of new boundaries at their quantiles;
+    * the caller must hold the rebalancing lock
+    */
+   void redistribute();
+public:
+  /**
+   * Constructs an empty tree of the specified number of shards
+   * @param count the number of shards, at least 1
+   * @param sample keys drawn from the expected items, in any order, whose
+   * quantiles become the boundaries of the shards; if it is empty, all the
+   * items go to the first shard until it is split
+   * @throws BstreeException if count is less than 1
+   */
+   ShardedBstree(long count, const vector<T>& sample = vector<T>());
+
+  /**
+   * A sharded tree is shared by threads, not copied
+   */
+   ShardedBstree(const ShardedBstree<T>& other) = delete;
+
+  /**
+   * A sharded tree is shared by threads, not assigned
+   */
+   ShardedBstree<T>& operator=(const ShardedBstree<T>& other) = delete;
+
+  /**
+   * Determines whether the tree is empty.
+   * @return true if the tree is empty; otherwise, false
+   */
+   bool empty() const;
+
+  /**
+   * Gives the number of items in this tree
+   * @return the sum of the sizes of the shards
+   */
+   long size() const;
+
+  /**
+   * Gives the number of shards of this tree
+   * @return the number of shards
+   */
+   long shardCount() const;
+
+  /**
+   * Inserts an item into the tree, or overwrites the item with the same
+   * key; it may rebalance the shards afterwards
+   * @param item the value to be inserted.
+   */
+   void insert(T item);
+
+  /**
+   * Determines whether an item is in the tree.
+   * @param item item with a specified search key.
+   * @return true on success; false on failure.
+   */
+   bool inTree(const T& item) const;
+
+  /**
+   * Deletes an item from the tree.
+   * @param item item with a specified search key.
+   * @return true on success; false on failure.
+   */
+   bool remove(const T& item);
+
+  /**
+   * Gives a copy of the item in the tree with the specified key; a
+   * reference could be invalidated by another thread at any time
+   * @param key the key to the item to be retrieved.
+   * @return a copy of the item with the specified key.
+   * @throws BstreeException if the item with the specified key is not
+   * in the tree
+   */
+   T retrieve(const T& key) const;
+
+   /**
+    * Gives a copy of the smallest item of this tree
+    * @return the smallest item of this tree
+    * @throw BstreeException when this tree is empty
+    */
+   T min() const;
+
+   /**
+    * Gives a copy of the largest item of this tree
+    * @return the largest item of this tree
+    * @throw BstreeException when this tree is empty
+    */
+   T max() const;
+
+  /**
+   * Traverses the shards in order, each in inorder, so that apply is
+   * called once for each item in ascending order. All the shards are
+   * locked for the whole traversal, which sees a consistent snapshot;
+   * apply must not use this tree.
+   * @param apply a pointer to a function of type (const T&) -> void
+   */
+   void inorderTraverse(FuncType apply) const;
+
+   /**
+    * Chooses the boundaries of all the shards again at the quantiles of
+    * the items and moves the items to their new shards, each of which is
+    * left perfectly balanced. All the shards are locked while it runs, in
+    * O(n) time; nodes are relinked, not copied.
+    */
+   void rebalance();
+
+   /**
+    * Sets how much larger than the average of the other shards a shard
+    * may grow before an insert splits its range; it is checked every
+    * 1024 inserts into the shard
+    * @param factor the imbalance factor, more than 1, 2 by default; 0
+    * turns automatic rebalancing off
+    * @throws BstreeException if the factor is out of range
+    */
+   void setAutoRebalance(double factor);
+
+   /**
+    * Gives the size of every shard that holds a range, in key order
+    * @return the number of items in each range
+    */
+   vector<long> shardSizes() const;
+
+   /**
+    * Gives statistics of the shards, each shard being locked in turn; no
+    * range changes hands while it runs
+    * @return the sizes, shapes and operation counters of the shards,
+    * aggregated
+    */
+   ShardedBstreeStats stats() const;
+};
+#endif //SHARDED_BSTREE_H
@@ -0,0 +1,280 @@
+/**
+ * A multi-threaded throughput benchmark for the sharded binary search tree
+ * @author ketsubetsu
+ * @see ShardedBstree
+ * <pre>
+ * File: ShardedBstreeBench.cpp
+ * Build: g++ -std=c++17 -O2 -pthread -o sharded_bench ShardedBstreeBench.cpp
+ *
+ * Every run fills a ShardedBstree<int> or a ShardedBstree<string> with
+ * --size keys from one thread and then lets the given number of threads
+ * run --ops operations between them, a mix of insert, lookup and remove,
+ * each thread with keys of its own generator. The throughput is the
+ * number of operations over the wall-clock time from the start of the
+ * first thread to the end of the last.
+ *
+ * Usage: sharded_bench [--threads=1,2,4,...] [--shards=1,64] [--types=int,string]
+ *                      [--size=N] [--ops=N] [--mix=insert:lookup:remove]
+ *                      [--partition=sample,adaptive] [--order=random,ascending]
+ *                      [--seed=N]
+ * --threads : the thread counts; 1,2,4,8,16,32,64 by default
+ * --shards : the shard counts; 1,64 by default, 1 being a single locked tree
+ * --size : the number of keys before the timed operations; 1e6 by default
+ * --ops : the number of timed operations of all the threads; 1e6 by default
+ * --mix : the relative weights of the operations; 20:70:10 by default
+ * --partition : how the shard boundaries are chosen; sample takes them from
+ *               1024 random keys before filling, adaptive starts with one
+ *               range and rebalances as the tree fills; sample by default
+ * --order : the order of the keys; random keys are uniform over twice the
+ *           size, ascending keys fill the tree in order and the timed
+ *           inserts keep ascending while lookups and removes are uniform
+ *           over the filled keys; random by default
+ *
+ * The results are written to the standard output as a JSON array with one
+ * object per run.
+ * </pre>
+ */
+
+#include <cstring>
+#include <random>
+#include <thread>
+#include "Bstree.cpp"
+#include "ShardedBstree.cpp"
+#include "BenchSupport.h"
+
+using namespace std;
+
+/**
+ * the description of a benchmark run
+ */
+struct ShardedBenchConfig : BenchConfig
+{
+   /**
+    * the number of threads running the timed operations
+    */
+   long threads;
+   /**
+    * the number of shards of the tree
+    */
+   long shards;
+   /**
+    * how the shard boundaries are chosen; "sample" or "adaptive"
+    */
+   string partition;
+   /**
+    * the order of the keys; "random" or "ascending"
+    */
+   string order;
+   /**
+    * the relative weights of insert, lookup and remove
+    */
+   long mix[3];
+};
+
+/**
+ * The operations of one thread, generated before the clock starts
+ */
+template <typename K>
+struct Workload
+{
+   /**
+    * the keys of the operations
+    */
+   vector<K> keys;
+   /**
+    * the kinds of the operations; 0 insert, 1 lookup, 2 remove
+    */
+   vector<char> kinds;
+   /**
+    * the number of lookups and removes that found their key
+    */
+   long hits;
+};
+
+/**
+ * Runs the operations of one thread
+ * @param tree the tree shared by the threads
+ * @param work the operations of this thread
+ * @param go set when all the threads may start
+ */
+template <typename K>
+void runThread(ShardedBstree<K>& tree, Workload<K>& work, const atomic<bool>& go)
+{
+   long hits = 0;
+   while (!go.load(memory_order_acquire))
+      this_thread::yield();
+   for (size_t i = 0; i < work.keys.size(); i++)
+   {
+      switch (work.kinds[i])
+      {
+         case 0:
+            tree.insert(work.keys[i]);
+            break;
+         case 1:
+            hits += tree.inTree(work.keys[i]);
+            break;
+         default:
+            hits += tree.remove(work.keys[i]);
+      }
+   }
+   work.hits = hits;
+}
+
+/**
+ * Runs one benchmark and writes its result as a JSON object
+ * @param config the run to be benchmarked
+ * @param json the stream the result is written to
+ */
+template <typename K>
+void runBench(const ShardedBenchConfig& config, ostream& json)
+{
+   mt19937_64 rng(config.seed);
+   uint64_t span = 2 * static_cast<uint64_t>(std::max(config.size, 1L));
+   uniform_int_distribution<uint64_t> uniform(0, span - 1);
+   uniform_int_distribution<uint64_t> filled(0, span / 2 - 1);
+   bool ascending = config.order == "ascending";
+   K key;
+
+   vector<K> sample;
+   if (config.partition == "sample")
+      for (int i = 0; i < 1024; i++)
+      {
+         makeKey(ascending ? filled(rng) : uniform(rng), key);
+         sample.push_back(key);
+      }
+   ShardedBstree<K> tree(config.shards, sample);
+   auto start = chrono::steady_clock::now();
+   for (long i = 0; i < config.size; i++)
+   {
+      makeKey(ascending ? static_cast<uint64_t>(i) : uniform(rng), key);
+      tree.insert(key);
+   }
+   double fillNs = elapsedNs(start);
+   long startSize = tree.size();
+
+   vector<Workload<K>> work(config.threads);
+   discrete_distribution<int> pickOp(config.mix, config.mix + 3);
+   for (long t = 0; t < config.threads; t++)
+   {
+      long share = config.ops / config.threads + (t < config.ops % config.threads ? 1 : 0);
+      mt19937_64 mine(config.seed + 1 + t);
+      uint64_t inserts = 0;
+      work[t].hits = 0;
+      work[t].keys.reserve(share);
+      work[t].kinds.reserve(share);
+      for (long i = 0; i < share; i++)
+      {
+         uint64_t index = ascending ? 0 : uniform(mine);
+         char kind = static_cast<char>(pickOp(mine));
+         /* the threads take turns at the next ascending keys */
+         if (ascending)
+            index = kind == 0 ? config.size + t + config.threads * inserts++ : filled(mine);
+         makeKey(index, key);
+         work[t].keys.push_back(key);
+         work[t].kinds.push_back(kind);
+      }
+   }
+
+   atomic<bool> go(false);
+   vector<thread> threads;
+   for (long t = 0; t < config.threads; t++)
+      threads.emplace_back(runThread<K>, ref(tree), ref(work[t]), cref(go));
+   start = chrono::steady_clock::now();
+   go.store(true, memory_order_release);
+   for (thread& t : threads)
+      t.join();
+   double ns = elapsedNs(start);
+
+   long hits = 0;
+   for (const Workload<K>& w : work)
+      hits += w.hits;
+   ShardedBstreeStats stats = tree.stats();
+   json<<"{\"type\":\""<<config.type<<"\",\"threads\":"<<config.threads
+       <<",\"shards\":"<<config.shards<<",\"partition\":\""<<config.partition<<"\""
+       <<",\"order\":\""<<config.order<<"\""
+       <<",\"size\":"<<startSize
+       <<",\"fill_ns_per_op\":"<<(config.size ? fillNs / config.size : 0)
+       <<",\"ops\":"<<config.ops
+       <<",\"ns_per_op\":"<<(config.ops ? ns / config.ops : 0)
+       <<",\"ops_per_sec\":"<<(ns > 0 ? config.ops * 1e9 / ns : 0)
+       <<",\"hits\":"<<hits
+       <<",\"final_size\":"<<stats.size
+       <<",\"min_shard\":"<<stats.minShard<<",\"max_shard\":"<<stats.maxShard
+       <<",\"height\":"<<stats.height
+       <<",\"rebalances\":"<<stats.rebalances<<"}";
+}
+
+int main(int argc, char** argv)
+{
+   vector<string> threadCounts = {"1", "2", "4", "8", "16", "32", "64"};
+   vector<string> shardCounts = {"1", "64"};
+   vector<string> types = {"int"};
+   vector<string> partitions = {"sample"};
+   vector<string> orders = {"random"};
+   ShardedBenchConfig config;
+   config.size = 1000000;
+   config.ops = 1000000;
+   config.mix[0] = 20, config.mix[1] = 70, config.mix[2] = 10;
+   config.seed = 42;
+   for (int i = 1; i < argc; i++)
+   {
+      string arg = argv[i];
+      string value = optionValue(arg);
+      if (arg.rfind("--threads=", 0) == 0)
+         threadCounts = splitList(value);
+      else if (arg.rfind("--shards=", 0) == 0)
+         shardCounts = splitList(value);
+      else if (arg.rfind("--types=", 0) == 0)
+         types = splitList(value);
+      else if (arg.rfind("--partition=", 0) == 0)
+         partitions = splitList(value);
+      else if (arg.rfind("--order=", 0) == 0)
+         orders = splitList(value);
+      else if (arg.rfind("--size=", 0) == 0)
+         config.size = countValue(value);
+      else if (arg.rfind("--ops=", 0) == 0)
+         config.ops = countValue(value);
+      else if (arg.rfind("--seed=", 0) == 0)
+         config.seed = strtoul(value.c_str(), nullptr, 10);
+      else if (arg.rfind("--mix=", 0) == 0 &&
+               sscanf(value.c_str(), "%ld:%ld:%ld", &config.mix[0], &config.mix[1],
+                      &config.mix[2]) == 3)
+         continue;
+      else
+         exitWithUsage("sharded_bench [--threads=1,2,4,...] [--shards=1,64] [--types=int,string]"
+                       " [--size=N] [--ops=N] [--mix=insert:lookup:remove]"
+                       " [--partition=sample,adaptive] [--order=random,ascending] [--seed=N]");
+   }
+
+   JsonArray results(cout);
+   for (const string& type : types)
+      for (const string& order : orders)
+         for (const string& partition : partitions)
+            for (const string& shards : shardCounts)
+               for (const string& threads : threadCounts)
+               {
+                  config.type = type;
+                  config.order = order;
+                  config.partition = partition;
+                  config.shards = atol(shards.c_str());
+                  config.threads = atol(threads.c_str());
+                  results.next();
+                  if ((type != "int" && type != "string") ||
+                      (partition != "sample" && partition != "adaptive") ||
+                      (order != "random" && order != "ascending") ||
+                      config.shards < 1 || config.threads < 1)
+                  {
+                     cout<<"{\"type\":\""<<type<<"\",\"threads\":\""<<threads<<"\",\"shards\":\""<<shards
+                         <<"\",\"partition\":\""<<partition<<"\",\"order\":\""<<order
+                         <<"\",\"error\":\"unknown type, partition, order or count\"}";
+                     continue;
+                  }
+                  if (type == "int")
+                     runBench<int>(config, cout);
+                  else
+                     runBench<string>(config, cout);
+                  cout<<flush;
+               }
+   results.close();
+   return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * Implementation file for function of the StaticBstree<T, N> class
+ * @author ketsubetsu
+ * @see StaticBstree.h
+ * <pre>
+ * File: StaticBstree.cpp
+ * </pre>
+ */
+
+using namespace std;
+
+#include "StaticBstree.h"
+
+template <typename T, size_t N>
+constexpr StaticBstree<T, N>::StaticBstree(initializer_list<T> list) : items{}
+{
+   if (list.size() != N)
+      throw BstreeException("Exception: wrong number of items for StaticBstree.");
+   array<T, N> sorted{};
+   size_t count = 0;
+   /* insertion sort; N is small for fixed vocabularies */
+   for (const T& item : list)
+   {
+      size_t i = count++;
+      while (i > 0 && sorted[i - 1] > item)
+      {
+         sorted[i] = sorted[i - 1];
+         i--;
+      }
+      sorted[i] = item;
+   }
+   for (size_t i = 1; i < N; i++)
+      if (sorted[i - 1] == sorted[i])
+         throw BstreeException("Exception: duplicate item for StaticBstree.");
+   size_t next = 0;
+   place(sorted, next, 0);
+}
+
+template <typename T, size_t N>
+constexpr void StaticBstree<T, N>::place(const array<T, N>& sorted, size_t& next, size_t node)
+{
+   if (node < N)
+   {
+      place(sorted, next, 2 * node + 1);
+      items[node] = sorted[next++];
+      place(sorted, next, 2 * node + 2);
+   }
+}
+
+template <typename T, size_t N>
+constexpr size_t StaticBstree<T, N>::search(const T& key) const
+{
+   size_t node = 0;
+   while (node < N)
+   {
+      if (items[node] == key)
+         return node;
+      node = 2 * node + 1 + (key > items[node] ? 1 : 0);
+   }
+   return N;
+}
+
+template <typename T, size_t N>
+constexpr bool StaticBstree<T, N>::empty() const
+{
+   return N == 0;
+}
+
+template <typename T, size_t N>
+constexpr long StaticBstree<T, N>::size() const
+{
+   return static_cast<long>(N);
+}
+
+template <typename T, size_t N>
+constexpr long StaticBstree<T, N>::height() const
+{
+   long h = -1;
+   for (size_t count = N; count > 0; count /= 2)
+      h++;
+   return h;
+}
+
+template <typename T, size_t N>
+constexpr bool StaticBstree<T, N>::inTree(const T& item) const
+{
+   return search(item) != N;
+}
+
+template <typename T, size_t N>
+constexpr const T& StaticBstree<T, N>::retrieve(const T& key) const
+{
+   size_t node = search(key);
+   if (node == N)
+      throw BstreeException("Exception: non-existent key on retrieve().");
+   return items[node];
+}
+
+template <typename T, size_t N>
+constexpr const T& StaticBstree<T, N>::min() const
+{
+   if (N == 0)
+      throw BstreeException("Tree is empty");
+   size_t node = 0;
+   while (2 * node + 1 < N)
+      node = 2 * node + 1;
+   return items[node];
+}
+
+template <typename T, size_t N>
+constexpr const T& StaticBstree<T, N>::max() const
+{
+   if (N == 0)
+      throw BstreeException("Tree is empty");
+   size_t node = 0;
+   while (2 * node + 2 < N)
+      node = 2 * node + 2;
+   return items[node];
+}
+
+// Private auxiliary function for inorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::inorderTraverse(size_t node, FuncType apply) const
+{
+  if (node < N)
+  {
+    inorderTraverse(2 * node + 1, apply);
+    apply(items[node]);
+    inorderTraverse(2 * node + 2, apply);
+  }
+}
+
+// Private auxiliary function for preorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::preorderTraverse(size_t node, FuncType apply) const
+{
+  if (node < N)
+  {
+    apply(items[node]);
+    preorderTraverse(2 * node + 1, apply);
+    preorderTraverse(2 * node + 2, apply);
+  }
+}
+
+// Private auxiliary function for postorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::postorderTraverse(size_t node, FuncType apply) const
+{
+  if (node < N)
+  {
+    postorderTraverse(2 * node + 1, apply);
+    postorderTraverse(2 * node + 2, apply);
+    apply(items[node]);
+  }
+}
+
+// Public function for inorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::inorderTraverse(FuncType apply) const
+{
+  inorderTraverse(0, apply);
+}
+
+// Public function for preorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::preorderTraverse(FuncType apply) const
+{
+  preorderTraverse(0, apply);
+}
+
+// Public function for postorderTraverse
+template <typename T, size_t N>
+void StaticBstree<T, N>::postorderTraverse(FuncType apply) const
+{
+  postorderTraverse(0, apply);
+}
@@ -0,0 +1,158 @@
+/**
+ * The specification for a fixed binary search tree that can be built at
+ * compile time.
+ * @author ketsubetsu
+ * <pre>
+ * File: StaticBstree.h
+ * </pre>
+ */
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include "Bstree.h"
+
+#ifndef STATIC_BSTREE_H
+#define STATIC_BSTREE_H
+
+using namespace std;
+
+/**
+ * A binary search tree of a fixed set of N distinct items, built in a
+ * constexpr context, e.g.
+ * <pre>
+ * constexpr StaticBstree<string_view, 3> months{"JANUARY", "FEBRUARY", "MARCH"};
+ * static_assert(months.inTree("MARCH"));
+ * </pre>
+ * The items are kept sorted in a complete binary tree laid out as an
+ * implicit array (in Eytzinger order: the children of items[i] are
+ * items[2i+1] and items[2i+2]), so the tree is always balanced, uses no
+ * heap memory and has no pointers to chase. A search picks the next index
+ * arithmetically from the result of one comparison.
+ * @param <T> the data type of the items; a literal type with == and >
+ * @param <N> the number of items
+ */
+template <typename T, size_t N>
+class StaticBstree
+{
+private:
+   /**
+    * forward declaration of a function pointer of type (const T&) -> void
+    */
+   typedef void (*FuncType)(const T& item);
+   /**
+    * the items of this tree in Eytzinger order
+    */
+   array<T, N> items;
+   /**
+    * Recursively places sorted items into the subtree at the specified index
+    * so that an inorder traversal gives them back in order
+    * @param sorted the items in ascending order
+    * @param next the index of the next sorted item to be placed
+    * @param node the index of the root of a subtree
+    */
+   constexpr void place(const array<T, N>& sorted, size_t& next, size_t node);
+   /**
+    * Gives the index of the item equal to the specified key
+    * @param key the search key
+    * @return the index of the item equal to key, or N if there is none
+    */
+   constexpr size_t search(const T& key) const;
+   /**
+    * Traverses the subtree at the specified index in inorder
+    * @param node the index of the root of a subtree
+    * @param apply a pointer to a function of type (const T&) -> void
+    */
+   void inorderTraverse(size_t node, FuncType apply) const;
+   /**
+    * Traverses the subtree at the specified index in preorder
+    * @param node the index of the root of a subtree
+    * @param apply a pointer to a function of type (const T&) -> void
+    */
+   void preorderTraverse(size_t node, FuncType apply) const;
+   /**
+    * Traverses the subtree at the specified index in postorder
+    * @param node the index of the root of a subtree
+    * @param apply a pointer to a function of type (const T&) -> void
+    */
+   void postorderTraverse(size_t node, FuncType apply) const;
+public:
+  /**
+   * Constructs a tree of the specified items, sorting them in O(N^2) time
+   * @param list the N distinct items of this tree, in any order
+   * @throws BstreeException if the list does not hold exactly N items or
+   * holds two equal items; in a constexpr context this is a compile error
+   */
+   constexpr StaticBstree(initializer_list<T> list);
+
+  /**
+   * Determines whether the tree is empty.
+   * @return true if the tree is empty; otherwise, false
+   */
+   constexpr bool empty() const;
+
+  /**
+   * Gives the number of node in this tree
+   * @return the size of the tree; the number of nodes in this tree.
+   */
+   constexpr long size() const;
+
+  /**
+   * Gives the height of this tree, floor(log2(N))
+   * @return the height of this tree
+   */
+   constexpr long height() const;
+
+  /**
+   * Determines whether an item is in the tree.
+   * @param item item with a specified search key.
+   * @return true on success; false on failure.
+   */
+   constexpr bool inTree(const T& item) const;
+
+  /**
+   * Returns the item in the tree with the specified
+   * key. If the item does not exists, an exception occurs.
+   * @param key the key to the item to be retrieved.
+   * @return it with the specified key.
+   * @throws BstreeException if the item with the specified key is not
+   * in the tree
+   */
+   constexpr const T& retrieve(const T& key) const;
+
+   /**
+    * Gives the item in the left-most node of this tree.
+    * @return the item in the left-most node of this tree
+    * @throw BstreeException when this tree is empty
+    */
+   constexpr const T& min() const;
+
+   /**
+    * Gives the item in the right-most node of this tree.
+    * @return the item in the right-most node of this tree
+    * @throw BstreeException when this tree is empty
+    */
+   constexpr const T& max() const;
+
+  /**
+   * Traverses the tree in inorder and applies the function apply once for
+   * each node.
+   * @param apply a pointer to a function of type (const T&) -> void
+   */
+   void inorderTraverse(FuncType apply) const;
+
+  /**
+   * Traverses the tree in preorder and applies the function apply once
+   * for each node.
+   * @param apply a pointer to a function of type (const T&) -> void
+   */
+   void preorderTraverse(FuncType apply) const;
+
+  /**
+   * Traverses the tree in postorder and applies the function apply once
+   * for each node.
+   * @param apply a pointer to a function of type (const T&) -> void
+   */
+   void postorderTraverse(FuncType apply) const;
+};
+#endif //STATIC_BSTREE_H
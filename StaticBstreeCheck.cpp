@@ -0,0 +1,78 @@
+/**
+ * A program that checks the StaticBstree implementation at compile time
+ * @author ketsubetsu
+ * @see StaticBstree
+ * <pre>
+ * File: StaticBstreeCheck.cpp
+ * Builds the trees below in constexpr contexts and checks them with
+ * static_assert, so the program compiles only if they hold; once built it
+ * displays the items of the twelve-month tree in inorder and preorder,
+ * one traversal per line.
+ * A duplicate item, e.g.
+ *    constexpr StaticBstree<int, 2> twice{1, 1};
+ * or a wrong number of items throws BstreeException in the constructor,
+ * which is a compile error in a constexpr context; a static_assert cannot
+ * test that, so it is left out here.
+ *
+ * Build: g++ -std=c++17 -o StaticBstreeCheck StaticBstreeCheck.cpp
+ * Usage: StaticBstreeCheck
+ * </pre>
+ */
+
+#include <iostream>
+#include <string_view>
+#include "StaticBstree.cpp"
+
+using namespace std;
+
+/**
+ * the months of months.bst, in calendar order
+ */
+constexpr StaticBstree<string_view, 12> months{"JANUARY", "FEBRUARY",
+   "MARCH", "APRIL", "MAY", "JUNE", "JULY", "AUGUST", "SEPTEMBER",
+   "OCTOBER", "NOVEMBER", "DECEMBER"};
+
+static_assert(months.size() == 12 && !months.empty());
+static_assert(months.height() == 3);
+static_assert(months.inTree("JANUARY") && months.inTree("MARCH") &&
+   months.inTree("DECEMBER"));
+static_assert(!months.inTree("AAA") && !months.inTree("JUNO") &&
+   !months.inTree("ZZZ"));
+static_assert(months.retrieve("MAY") == "MAY");
+static_assert(months.min() == "APRIL" && months.max() == "SEPTEMBER");
+
+/**
+ * a tree of one item
+ */
+constexpr StaticBstree<int, 1> one{7};
+
+static_assert(one.size() == 1 && one.height() == 0);
+static_assert(one.inTree(7) && !one.inTree(6) && !one.inTree(8));
+static_assert(one.min() == 7 && one.max() == 7);
+
+/**
+ * a tree of no items
+ */
+constexpr StaticBstree<int, 0> none{};
+
+static_assert(none.size() == 0 && none.empty());
+static_assert(none.height() == -1);
+static_assert(!none.inTree(0));
+
+/**
+ * Displays an item followed by a space
+ * @param item the item to be displayed
+ */
+void display(const string_view& item)
+{
+   cout<<item<<" ";
+}
+
+int main()
+{
+   months.inorderTraverse(display);
+   cout<<endl;
+   months.preorderTraverse(display);
+   cout<<endl;
+   return 0;
+}